@@ -0,0 +1,653 @@
+/*! \file bench_routines.cpp
+ *  \brief Microbenchmarks for the routines in routines.hpp.
+ *
+ *  Every case reports the mean time per operation, the bandwidth implied
+ *  by the bytes the operation must touch, and the number of heap
+ *  allocations per operation.  Allocations are counted by wrapping
+ *  malloc, calloc, realloc and posix_memalign at link time (see the
+ *  Makefile) and by replacing operator new.  Related cases sit next to
+ *  each other so per-element, contiguous and batched forms of the same
+ *  work can be compared directly.
+ *
+ *  usage: bench_routines [substring]  runs only cases whose name contains substring
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <gsl/gsl_spline.h>
+#include "routines.hpp"
+
+/* Allocation counting. */
+
+static std::atomic<size_t> allocations(0);
+
+extern "C" void *__real_malloc(size_t n);
+extern "C" void *__real_calloc(size_t n, size_t size);
+extern "C" void *__real_realloc(void *p, size_t n);
+extern "C" int   __real_posix_memalign(void **p, size_t alignment, size_t n);
+
+extern "C" void *__wrap_malloc(size_t n)
+{
+	allocations++;
+	return __real_malloc(n);
+}
+extern "C" void *__wrap_calloc(size_t n, size_t size)
+{
+	allocations++;
+	return __real_calloc(n,size);
+}
+extern "C" void *__wrap_realloc(void *p, size_t n)
+{
+	allocations++;
+	return __real_realloc(p,n);
+}
+extern "C" int __wrap_posix_memalign(void **p, size_t alignment, size_t n)
+{
+	allocations++;
+	return __real_posix_memalign(p,alignment,n);
+}
+
+void *operator new(size_t n)
+{
+	void *p;
+
+	allocations++;
+	if(!(p = __real_malloc(n ? n : 1)))
+		throw std::bad_alloc();
+	return p;
+}
+void *operator new[](size_t n)
+{
+	return operator new(n);
+}
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
+
+/* Timing. */
+
+//results are written here so the work is not optimized away
+static volatile double sink;
+
+static const char *filter = NULL;
+
+/*! \fn static double now(void)
+ *  \brief Seconds on a steady clock. */
+static double now(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*! \fn static void bench(const char *name, double bytes, F f)
+ *  \brief Time f(), which performs one operation touching bytes bytes,
+ *         and print a line of results.  The repeat count doubles until a
+ *         run lasts at least 0.2 s. */
+template<typename F>
+static void bench(const char *name, double bytes, F f)
+{
+	size_t reps = 1, a0;
+	double t0, t;
+
+	if(filter && !strstr(name,filter))
+		return;
+
+	f();	//warm up caches and first-touch pages
+	for(;;)
+	{
+		a0 = allocations;
+		t0 = now();
+		for(size_t r=0;r<reps;r++)
+			f();
+		t = now() - t0;
+		if(t>=0.2 || reps>=((size_t) 1<<30))
+			break;
+		reps *= 2;
+	}
+
+	printf("%-44s %12.1f ns/op %9.2f GB/s %9.2f allocs/op\n",name,1e9*t/reps,
+	       bytes>0 ? bytes*reps/t/1e9 : 0.0,(double) (allocations-a0)/reps);
+	fflush(stdout);
+}
+
+/* Cases. */
+
+static double fill(double *x, size_t n, double scale)
+{
+	for(size_t i=0;i<n;i++)
+		x[i] = scale*sin(0.37*i + 1.0);
+	return 0;
+}
+
+static double log_func(double x, void *params)
+{
+	return 1.0/(1.0 + pow(x/((double *) params)[0],3)) + 1e-4;
+}
+
+static void bench_allocators(void)
+{
+	const int n = 512, l = 512;
+	const int a = 64, b = 64, c = 64;
+	const int p = 32;
+	arena *ar = arena_create((size_t) a*b*c*sizeof(double) + (1<<20));
+
+	bench("two_dimensional_array 512x512",(double) n*l*8,[&]() {
+		double **x = two_dimensional_array(n,l);
+		sink = x[n-1][l-1];
+		deallocate_two_dimensional_array(x,n,l);
+	});
+	bench("two_dimensional_contiguous_array 512x512",(double) n*l*8,[&]() {
+		double **x = two_dimensional_contiguous_array(n,l);
+		sink = x[n-1][l-1];
+		deallocate_two_dimensional_contiguous_array(x,n,l);
+	});
+	bench("three_dimensional_array 64^3",(double) a*b*c*8,[&]() {
+		double ***x = three_dimensional_array(a,b,c);
+		sink = x[a-1][b-1][c-1];
+		deallocate_three_dimensional_array(x,a,b,c);
+	});
+	bench("three_dimensional_contiguous_array 64^3",(double) a*b*c*8,[&]() {
+		double ***x = three_dimensional_contiguous_array(a,b,c);
+		sink = x[a-1][b-1][c-1];
+		deallocate_three_dimensional_contiguous_array(x,a,b,c);
+	});
+	bench("three_dimensional_contiguous_array arena 64^3",(double) a*b*c*8,[&]() {
+		double ***x = three_dimensional_contiguous_array(a,b,c,ar);
+		sink = x[a-1][b-1][c-1];
+		arena_reset(ar);
+	});
+	bench("four_dimensional_array 32^4",(double) p*p*p*p*8,[&]() {
+		double ****x = four_dimensional_array(p,p,p,p);
+		sink = x[p-1][p-1][p-1][p-1];
+		deallocate_four_dimensional_array(x,p,p,p,p);
+	});
+	bench("four_dimensional_contiguous_array 32^4",(double) p*p*p*p*8,[&]() {
+		double ****x = four_dimensional_contiguous_array(p,p,p,p);
+		sink = x[p-1][p-1][p-1][p-1];
+		deallocate_four_dimensional_contiguous_array(x,p,p,p,p);
+	});
+	bench("calloc_double_array 1M",8e6,[&]() {
+		double *x = calloc_double_array(1<<20);
+		sink = x[0];
+		free(x);
+	});
+	bench("calloc_aligned_double_array 1M",8e6,[&]() {
+		double *x = calloc_aligned_double_array(1<<20);
+		sink = x[0];
+		free_aligned(x);
+	});
+
+	arena_destroy(ar);
+}
+
+static void bench_vectors(void)
+{
+	const size_t n = 4096;
+	double *v[9], *r[3];
+
+	for(int k=0;k<9;k++)
+	{
+		v[k] = calloc_aligned_double_array(n);
+		fill(v[k],n,1.0+k);
+	}
+	for(int k=0;k<3;k++)
+		r[k] = calloc_aligned_double_array(n);
+
+	//n 3-vectors as x = (v0,v1,v2), y = (v3,v4,v5)
+	bench("vector_cross_product 3d x4096",(double) n*9*8,[&]() {
+		for(size_t i=0;i<n;i++)
+		{
+			double x[3] = {v[0][i],v[1][i],v[2][i]};
+			double y[3] = {v[3][i],v[4][i],v[5][i]};
+			double *z = vector_cross_product(x,y,3);
+			r[0][i] = z[0];
+			r[1][i] = z[1];
+			r[2][i] = z[2];
+			free(z);
+		}
+	});
+	bench("vector_cross_product_in_place 3d x4096",(double) n*9*8,[&]() {
+		for(size_t i=0;i<n;i++)
+		{
+			double x[3] = {v[0][i],v[1][i],v[2][i]};
+			double y[3] = {v[3][i],v[4][i],v[5][i]};
+			double z[3];
+			vector_cross_product_in_place(z,x,y,3);
+			r[0][i] = z[0];
+			r[1][i] = z[1];
+			r[2][i] = z[2];
+		}
+	});
+	bench("vector_cross_product_batch_3d x4096",(double) n*9*8,[&]() {
+		vector_cross_product_batch_3d(r[0],r[1],r[2],v[0],v[1],v[2],v[3],v[4],v[5],n);
+	});
+	bench("vector_dot_product 3d x4096",(double) n*7*8,[&]() {
+		for(size_t i=0;i<n;i++)
+		{
+			double x[3] = {v[0][i],v[1][i],v[2][i]};
+			double y[3] = {v[3][i],v[4][i],v[5][i]};
+			r[0][i] = vector_dot_product(x,y,3);
+		}
+	});
+	bench("vector_dot_product_batch_3d x4096",(double) n*7*8,[&]() {
+		vector_dot_product_batch_3d(r[0],v[0],v[1],v[2],v[3],v[4],v[5],n);
+	});
+	bench("vector_magnitude 3d x4096",(double) n*4*8,[&]() {
+		for(size_t i=0;i<n;i++)
+		{
+			double x[3] = {v[0][i],v[1][i],v[2][i]};
+			r[0][i] = vector_magnitude(x,3);
+		}
+	});
+	bench("vector_magnitude_batch_3d x4096",(double) n*4*8,[&]() {
+		vector_magnitude_batch_3d(r[0],v[0],v[1],v[2],n);
+	});
+	bench("matrix_determinant 3x3 x4096",(double) n*10*8,[&]() {
+		double  a[3][3];
+		double *rows[3] = {a[0],a[1],a[2]};
+		for(size_t i=0;i<n;i++)
+		{
+			for(int k=0;k<9;k++)
+				a[k/3][k%3] = v[k][i];
+			r[0][i] = matrix_determinant(rows,3);
+		}
+	});
+	bench("matrix_determinant_batch_3d x4096",(double) n*10*8,[&]() {
+		matrix_determinant_batch_3d(r[0],v[0],v[1],v[2],v[3],v[4],v[5],v[6],v[7],v[8],n);
+	});
+
+	for(int k=0;k<9;k++)
+		free_aligned(v[k]);
+	for(int k=0;k<3;k++)
+		free_aligned(r[k]);
+}
+
+static void bench_tensors(void)
+{
+	const int    ndim  = 3;
+	const size_t count = 4096;
+	double **a = two_dimensional_contiguous_array(ndim,ndim);
+	double **s = two_dimensional_contiguous_array(ndim,ndim);
+	double **t = two_dimensional_contiguous_array(ndim,ndim);
+	double  *batch = calloc_aligned_double_array(count*ndim*ndim);
+	double  *out   = calloc_aligned_double_array(count*ndim*ndim);
+	double **m6 = two_dimensional_contiguous_array(6,6);
+
+	fill(a[0],ndim*ndim,1.0);
+	fill(s[0],ndim*ndim,2.0);
+	fill(batch,count*ndim*ndim,1.0);
+	for(int i=0;i<6;i++)
+		for(int j=0;j<6;j++)
+			m6[i][j] = (i==j ? 4.0 : 0.0) + sin(i + 7.0*j);
+
+	bench("tensor_transformation 3x3",9*3*8,[&]() {
+		double **r = tensor_transformation(a,s,ndim);
+		sink = r[2][2];
+		deallocate_two_dimensional_array(r,ndim,ndim);
+	});
+	bench("tensor_transformation_in_place 3x3",9*3*8,[&]() {
+		tensor_transformation_in_place(t,a,s,ndim);
+		sink = t[2][2];
+	});
+	bench("tensor_transformation_batch 3x3 x4096",(double) count*9*2*8,[&]() {
+		tensor_transformation_batch(out,a[0],batch,ndim,count);
+	});
+	bench("matrix_determinant 6x6 LU",36*8,[&]() {
+		sink = matrix_determinant(m6,6);
+	});
+
+	deallocate_two_dimensional_contiguous_array(a,ndim,ndim);
+	deallocate_two_dimensional_contiguous_array(s,ndim,ndim);
+	deallocate_two_dimensional_contiguous_array(t,ndim,ndim);
+	deallocate_two_dimensional_contiguous_array(m6,6,6);
+	free_aligned(batch);
+	free_aligned(out);
+}
+
+static void bench_reductions(void)
+{
+	const int n = 1<<22;
+	double *x = calloc_aligned_double_array(n);
+	double *y = calloc_aligned_double_array(n);
+	double *z = calloc_aligned_double_array(n);
+	float  *xf = calloc_aligned_float_array(n);
+	float  *yf = calloc_aligned_float_array(n);
+
+	fill(x,n,1.0);
+	fill(y,n,0.5);
+	for(int i=0;i<n;i++)
+	{
+		xf[i] = 1.0f;
+		yf[i] = 0.5f;
+	}
+
+	bench("array_max 4M",(double) n*8,[&]() { sink = array_max(x,n); });
+	bench("array_max_parallel 4M",(double) n*8,[&]() { sink = array_max_parallel(x,n); });
+	bench("array_minmax 4M",(double) n*8,[&]() { double lo, hi; array_minmax(x,n,&lo,&hi); sink = hi-lo; });
+	bench("array_minmax_parallel 4M",(double) n*8,[&]() { double lo, hi; array_minmax_parallel(x,n,&lo,&hi); sink = hi-lo; });
+	bench("vector_dot_product 4M",(double) n*16,[&]() { sink = vector_dot_product(x,y,n); });
+	bench("vector_dot_product pairwise 4M",(double) n*16,[&]() { sink = vector_dot_product(x,y,n,SUMMATION_PAIRWISE); });
+	bench("vector_dot_product compensated 4M",(double) n*16,[&]() { sink = vector_dot_product(x,y,n,SUMMATION_COMPENSATED); });
+	bench("vector_dot_product_parallel 4M",(double) n*16,[&]() { sink = vector_dot_product_parallel(x,y,n); });
+	bench("array_max float 4M",(double) n*4,[&]() { sink = array_max(xf,n); });
+	bench("array_minmax float 4M",(double) n*4,[&]() { float lo, hi; array_minmax(xf,n,&lo,&hi); sink = hi-lo; });
+	bench("vector_dot_product float 4M",(double) n*8,[&]() { sink = vector_dot_product(xf,yf,n); });
+	bench("vector_magnitude 4M",(double) n*8,[&]() { sink = vector_magnitude(x,n); });
+	bench("vector_magnitude_scaled 4M",(double) n*8,[&]() { sink = vector_magnitude_scaled(x,n); });
+	bench("stream_dot 4M in 64k pieces",(double) n*16,[&]() {
+		stream_dot d;
+		stream_dot_init(&d);
+		for(int i=0;i<n;i+=65536)
+			stream_dot_update(&d,x+i,y+i,65536);
+		sink = stream_dot_finalize(&d);
+	});
+	bench("stream_minmax 4M in 64k pieces",(double) n*8,[&]() {
+		stream_minmax s;
+		double lo, hi;
+		stream_minmax_init(&s);
+		for(int i=0;i<n;i+=65536)
+			stream_minmax_update(&s,x+i,65536);
+		stream_minmax_finalize(&s,&lo,&hi);
+		sink = hi-lo;
+	});
+	bench("qsort compare_doubles 4M",(double) n*8,[&]() {
+		memcpy(z,x,(size_t) n*sizeof(double));
+		qsort(z,n,sizeof(double),compare_doubles);
+	});
+	bench("array_sort 4M",(double) n*8,[&]() {
+		memcpy(z,x,(size_t) n*sizeof(double));
+		array_sort(z,n);
+	});
+	bench("array_sort_parallel 4M",(double) n*8,[&]() {
+		memcpy(z,x,(size_t) n*sizeof(double));
+		array_sort_parallel(z,n);
+	});
+
+	free_aligned(x);
+	free_aligned(y);
+	free_aligned(z);
+	free_aligned(xf);
+	free_aligned(yf);
+}
+
+/*! \fn static void remove_directory(const char *dir)
+ *  \brief Remove dir and the files directly in it. */
+static void remove_directory(const char *dir)
+{
+	char           path[512];
+	DIR           *d;
+	struct dirent *e;
+
+	if((d = opendir(dir)))
+	{
+		while((e = readdir(d)))
+		{
+			if(!strcmp(e->d_name,".") || !strcmp(e->d_name,".."))
+				continue;
+			snprintf(path,sizeof(path),"%s/%s",dir,e->d_name);
+			unlink(path);
+		}
+		closedir(d);
+	}
+	rmdir(dir);
+}
+
+static void bench_splines(void)
+{
+	const int nodes = 1000;
+	const int n     = 1<<16;
+	double params[1] = {10.0};
+	double *log10x = calloc_double_array(nodes);
+	double *q      = calloc_aligned_double_array(n);
+	double *r      = calloc_aligned_double_array(n);
+	double *log10y;
+	gsl_spline       *spline;
+	gsl_interp_accel *acc;
+	uniform_spline   *us;
+	uniform_spline_float *uf;
+	float *qf = calloc_aligned_float_array(n);
+	float *rf = calloc_aligned_float_array(n);
+	char   cache_dir[] = "/tmp/bench_routines_XXXXXX";
+
+	fill_linear_grid(log10x,nodes,-3.0,3.0);
+	for(int i=0;i<n;i++)
+	{
+		q[i]  = -3.0 + 6.0*((i*2654435761u) % n)/n;
+		qf[i] = (float) q[i];
+	}
+
+	bench("double_log10_index x1000",nodes*8,[&]() {
+		for(int i=0;i<nodes;i++)
+			log10x[i] = log10(double_log10_index(i,nodes,1e-3,1e3));
+	});
+	bench("fill_log10_grid 1000",nodes*8,[&]() {
+		fill_log10_grid(log10x,nodes,1e-3,1e3);
+	});
+	fill_linear_grid(log10x,nodes,-3.0,3.0);
+
+	bench("create_log10_spline 1000",nodes*16,[&]() {
+		create_log10_spline(log_func,log10x,log10y,nodes,params,spline,acc);
+		gsl_spline_free(spline);
+		gsl_interp_accel_free(acc);
+		free(log10y);
+	});
+	bench("create_log10_spline_parallel 1000",nodes*16,[&]() {
+		create_log10_spline_parallel(log_func,log10x,log10y,nodes,params,spline,acc);
+		gsl_spline_free(spline);
+		gsl_interp_accel_free(acc);
+		free(log10y);
+	});
+	bench("create_linear_spline_parallel 1000",nodes*16,[&]() {
+		create_linear_spline_parallel(log_func,log10x,log10y,nodes,params,spline,acc);
+		gsl_spline_free(spline);
+		gsl_interp_accel_free(acc);
+		free(log10y);
+	});
+	if(mkdtemp(cache_dir))
+	{
+		//the first, warm-up, call fills the cache that the rest read
+		bench("create_log10_spline_cached 1000 hit",nodes*16,[&]() {
+			create_log10_spline_cached(cache_dir,"log_func",log_func,log10x,log10y,nodes,params,1,spline,acc);
+			gsl_spline_free(spline);
+			gsl_interp_accel_free(acc);
+			free(log10y);
+		});
+		bench("create_linear_spline_cached 1000 hit",nodes*16,[&]() {
+			create_linear_spline_cached(cache_dir,"log_func",log_func,log10x,log10y,nodes,params,1,spline,acc);
+			gsl_spline_free(spline);
+			gsl_interp_accel_free(acc);
+			free(log10y);
+		});
+		remove_directory(cache_dir);
+	}
+	bench("create_log10_spline_adaptive tol 1e-6",0,[&]() {
+		double *ax, *ay;
+		int     an = 64;
+		sink = create_log10_spline_adaptive(log_func,-3.0,3.0,1e-6,ax,ay,an,params,spline,acc);
+		gsl_spline_free(spline);
+		gsl_interp_accel_free(acc);
+		free(ax);
+		free(ay);
+	});
+	bench("create_log10_uniform_spline 1000",nodes*16,[&]() {
+		uniform_spline *u = create_log10_uniform_spline(log_func,-3.0,3.0,nodes,params);
+		uniform_spline_free(u);
+	});
+
+	create_log10_spline(log_func,log10x,log10y,nodes,params,spline,acc);
+	us = create_log10_uniform_spline(log_func,-3.0,3.0,nodes,params);
+	uf = create_log10_uniform_spline_float(log_func,-3.0,3.0,nodes,params);
+
+	bench("gsl_spline_eval random x65536",(double) n*16,[&]() {
+		for(int i=0;i<n;i++)
+			r[i] = gsl_spline_eval(spline,q[i],acc);
+	});
+	bench("spline_eval_many random x65536",(double) n*16,[&]() {
+		spline_eval_many(spline,q,n,r);
+	});
+	bench("uniform_spline_eval random x65536",(double) n*16,[&]() {
+		for(int i=0;i<n;i++)
+			r[i] = uniform_spline_eval(us,q[i]);
+	});
+	bench("uniform_spline_eval_many random x65536",(double) n*16,[&]() {
+		uniform_spline_eval_many(us,q,n,r);
+	});
+	bench("uniform_spline_eval_many float random x65536",(double) n*8,[&]() {
+		uniform_spline_eval_many(uf,qf,n,rf);
+	});
+
+	gsl_spline_free(spline);
+	gsl_interp_accel_free(acc);
+	uniform_spline_free(us);
+	uniform_spline_free(uf);
+	free(log10x);
+	free(log10y);
+	free_aligned(q);
+	free_aligned(r);
+	free_aligned(qf);
+	free_aligned(rf);
+}
+
+static void bench_io(void)
+{
+	const int n = 1<<20;
+	const int l = 256, m = 4096;
+	double  *x = calloc_aligned_double_array(n);
+	double **y = two_dimensional_array(l,m);
+	double  *cx;
+	char     fname[] = "/tmp/bench_routines_XXXXXX";
+	FILE    *fp;
+	int      fd;
+
+	if(!(fp = tmpfile()))
+	{
+		printf("Error: could not open a temporary file.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	fill(x,n,1.0);
+
+	bench("write_double_array+read_double_array 8MB",2.0*n*8,[&]() {
+		int nr;
+		rewind(fp);
+		write_double_array(fp,x,n);
+		fflush(fp);
+		rewind(fp);
+		double *r = read_double_array(fp,&nr);
+		sink = r[nr-1];
+		free(r);
+	});
+	bench("fwrite_brant+fread_brant 8MB",2.0*n*8,[&]() {
+		rewind(fp);
+		fwrite_brant(x,sizeof(double),n,fp);
+		fflush(fp);
+		rewind(fp);
+		fread_brant(x,sizeof(double),n,fp);
+		sink = x[n-1];
+	});
+	bench("write_two_dimensional_array per-row 8MB",(double) l*m*8,[&]() {
+		rewind(fp);
+		write_two_dimensional_array(fp,y,l,m);
+		fflush(fp);
+	});
+	rewind(fp);
+	write_double_array(fp,x,n);
+	fflush(fp);
+	bench("chunk_reader 8MB in 256k chunks",(double) n*8,[&]() {
+		chunk_reader *r;
+		stream_minmax s;
+		double lo, hi;
+		size_t k;
+		rewind(fp);
+		r = chunk_reader_open(fp,1,1<<18);
+		stream_minmax_init(&s);
+		while((k = chunk_reader_next(r,&cx)))
+			stream_minmax_update(&s,cx,k);
+		chunk_reader_close(r);
+		stream_minmax_finalize(&s,&lo,&hi);
+		sink = hi-lo;
+	});
+
+	//the map_* routines need a named file
+	if((fd = mkstemp(fname))>=0)
+	{
+		FILE *fm = fdopen(fd,"w");
+		write_double_array(fm,x,n);
+		fclose(fm);
+		bench("map_double_array+unmap 8MB sequential",(double) n*8,[&]() {
+			int     nm;
+			double *xm = map_double_array(fname,&nm,ARRAY_MAP_READ_ONLY,ARRAY_ADVICE_SEQUENTIAL);
+			sink = array_max(xm,nm);
+			unmap_double_array(xm,nm);
+		});
+		bench("map_double_array copy-on-write 8MB",(double) n*8,[&]() {
+			int     nm;
+			double *xm = map_double_array(fname,&nm,ARRAY_MAP_COPY_ON_WRITE);
+			xm[0] = 1;
+			sink = array_max(xm,nm);
+			unmap_double_array(xm,nm);
+		});
+
+		fm = fopen_brant(fname,"w");
+		write_two_dimensional_array(fm,y,l,m);
+		fclose(fm);
+		bench("map_two_dimensional_array+unmap 8MB",(double) l*m*8,[&]() {
+			int      nm, lm;
+			double **ym = map_two_dimensional_array(fname,&nm,&lm);
+			sink = array_max(ym[0],(size_t) nm*lm);
+			unmap_two_dimensional_array(ym,nm,lm);
+		});
+		unlink(fname);
+	}
+
+	fclose(fp);
+	free_aligned(x);
+	deallocate_two_dimensional_array(y,l,m);
+}
+
+static void bench_timers(void)
+{
+	timer_region *r = timer_region_get("bench");
+	timer_region *c = timer_region_get("bench cpu",true);
+
+	timer_summary_at_exit(false);
+	bench("wall_time",0,[&]() { sink = wall_time(); });
+	bench("thread_cpu_time",0,[&]() { sink = thread_cpu_time(); });
+	bench("timer_region_add",0,[&]() { timer_region_add(r,1e-6); });
+	bench("scoped_timer",0,[&]() { scoped_timer t(r); });
+	bench("scoped_timer cpu_time",0,[&]() { scoped_timer t(c); });
+}
+
+int main(int argc, char **argv)
+{
+	if(argc>1)
+		filter = argv[1];
+
+	printf("SIMD kernels: %s\n",simd_isa_name());
+	bench_allocators();
+	bench_vectors();
+	bench_tensors();
+	bench_reductions();
+	bench_splines();
+	bench_io();
+	bench_timers();
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*! \file fixed_dim.hpp
+ *  \brief Header-only vector and tensor routines with the dimension
+ *         fixed at compile time.
+ *
+ *  Vec<N> and Mat<N> are plain aggregates held by value, so these
+ *  overloads allocate nothing and, with N known to the compiler, inline
+ *  to straight-line code.  They sum in the same order as the
+ *  runtime-ndim routines in routines.hpp, except that vector_dot_product
+ *  there splits sums of four or more terms across lanes.
+ *
+ *  routines.cpp keeps fma contraction out of those routines, but this
+ *  header leaves it to the caller's build: with -march flags that
+ *  enable fma, compile with -ffp-contract=off, as bench/Makefile does,
+ *  for these to give the same bits as the routines they follow.
+ */
+#ifndef  BRANT_FIXED_DIM
+#define  BRANT_FIXED_DIM
+#include<math.h>
+
+/*! \struct Vec
+ *  \brief N-vector of doubles, e.g. Vec<3> v = {{1,2,3}}. */
+template<int N>
+struct Vec
+{
+	double x[N];
+
+	double       &operator[](int i)       { return x[i]; }
+	const double &operator[](int i) const { return x[i]; }
+
+	/*! \fn static Vec<N> from(const double *p)
+	 *  \brief Copy N doubles starting at p into a Vec. */
+	static Vec<N> from(const double *p)
+	{
+		Vec<N> v;
+		for(int i=0;i<N;i++)
+			v.x[i] = p[i];
+		return v;
+	}
+};
+
+/*! \struct Mat
+ *  \brief N x N matrix or second rank tensor of doubles, row major. */
+template<int N>
+struct Mat
+{
+	double a[N][N];
+
+	double       *operator[](int i)       { return a[i]; }
+	const double *operator[](int i) const { return a[i]; }
+
+	/*! \fn static Mat<N> from(double **p)
+	 *  \brief Copy an (N x N) array, e.g. from two_dimensional_array, into a Mat. */
+	static Mat<N> from(double **p)
+	{
+		Mat<N> m;
+		for(int i=0;i<N;i++)
+			for(int j=0;j<N;j++)
+				m.a[i][j] = p[i][j];
+		return m;
+	}
+};
+
+/*! \fn double vector_dot_product(const Vec<N> &x, const Vec<N> &y)
+ *  \brief Find the dot product of x * y */
+template<int N>
+inline double vector_dot_product(const Vec<N> &x, const Vec<N> &y)
+{
+	double dot = 0;
+	for(int i=0;i<N;i++)
+		dot += x[i]*y[i];
+	return dot;
+}
+
+/*! \fn double vector_magnitude(const Vec<N> &x)
+ *  \brief Find the magnitude of x */
+template<int N>
+inline double vector_magnitude(const Vec<N> &x)
+{
+	return sqrt(vector_dot_product(x,x));
+}
+
+/*! \fn double vector_cross_product(const Vec<2> &x, const Vec<2> &y)
+ *  \brief Find the (scalar) cross product of 2-vectors x x y */
+inline double vector_cross_product(const Vec<2> &x, const Vec<2> &y)
+{
+	return x[0]*y[1] - x[1]*y[0];
+}
+
+/*! \fn Vec<3> vector_cross_product(const Vec<3> &x, const Vec<3> &y)
+ *  \brief Find the cross product of 3-vectors x x y */
+inline Vec<3> vector_cross_product(const Vec<3> &x, const Vec<3> &y)
+{
+	Vec<3> r;
+	r[0] = x[1]*y[2] - x[2]*y[1];
+	r[1] = x[2]*y[0] - x[0]*y[2];
+	r[2] = x[0]*y[1] - x[1]*y[0];
+	return r;
+}
+
+/*! \fn double matrix_determinant(const Mat<2> &a)
+ *  \brief Find the determinant of a 2x2 matrix or tensor */
+inline double matrix_determinant(const Mat<2> &a)
+{
+	return a[0][0]*a[1][1] - a[1][0]*a[0][1];
+}
+
+/*! \fn double matrix_determinant(const Mat<3> &a)
+ *  \brief Find the determinant of a 3x3 matrix or tensor */
+inline double matrix_determinant(const Mat<3> &a)
+{
+	double det = 0;
+	det += a[0][0]*a[1][1]*a[2][2] + a[0][1]*a[1][2]*a[2][0];
+	det += a[0][2]*a[1][0]*a[2][1] - a[0][2]*a[1][1]*a[2][0];
+	det -= a[0][1]*a[1][0]*a[2][2] + a[0][0]*a[1][2]*a[2][1];
+	return det;
+}
+
+/*! \fn Mat<N> tensor_transformation(const Mat<N> &a, const Mat<N> &sigma)
+ *  \brief Apply transformation a to tensor sigma, s' = a s a^T.
+ *
+ *  The intermediate t = sigma a^T is formed once, so the cost is
+ *  O(N^3) rather than the O(N^4) of evaluating a_nj a_mi s_ji directly. */
+template<int N>
+inline Mat<N> tensor_transformation(const Mat<N> &a, const Mat<N> &sigma)
+{
+	Mat<N> t;
+	Mat<N> r;
+
+	//t_jm = sum_i sigma_ji a_mi
+	for(int j=0;j<N;j++)
+		for(int m=0;m<N;m++)
+		{
+			double y = 0;
+			for(int i=0;i<N;i++)
+				y += a[m][i]*sigma[j][i];
+			t[j][m] = y;
+		}
+
+	//r_nm = sum_j a_nj t_jm
+	for(int n=0;n<N;n++)
+		for(int m=0;m<N;m++)
+		{
+			double x = 0;
+			for(int j=0;j<N;j++)
+				x += a[n][j]*t[j][m];
+			r[n][m] = x;
+		}
+
+	return r;
+}
+
+#endif //BRANT_FIXED_DIM
@@ -0,0 +1,287 @@
+/*! \file ndarray.hpp
+ *  \brief Header-only strided N-dimensional array with zero-copy views.
+ */
+#ifndef  BRANT_NDARRAY
+#define  BRANT_NDARRAY
+#include<stdio.h>
+#include<stdlib.h>
+#include<stddef.h>
+#include<math.h>
+#include<memory>
+#include<type_traits>
+#include"routines.hpp"
+
+/*! \class NdArray
+ *  \brief Rank-dimensional array of T with runtime extents and strides.
+ *
+ *  An NdArray either owns a contiguous, zeroed, row-major buffer from
+ *  calloc_aligned or is a view into one.  Views produced by slice(),
+ *  transpose() and block() share the buffer with their parent (no copy)
+ *  and keep it alive, so a view may outlive the array it was taken from.
+ *  Strides are counted in elements, not bytes.
+ */
+template<typename T, int Rank>
+class NdArray
+{
+	static_assert(std::is_trivial<T>::value, "NdArray: T must be a trivial type");
+
+	template<typename U, int R> friend class NdArray;
+
+	public:
+
+	/*! \fn NdArray()
+	 *  \brief Empty array, all extents zero. */
+	NdArray() : data_(NULL)
+	{
+		for(int d=0;d<Rank;d++)
+		{
+			extent_[d] = 0;
+			stride_[d] = 0;
+		}
+	}
+
+	/*! \fn NdArray(Extents... extents)
+	 *  \brief Allocate a zeroed, contiguous row-major array with the
+	 *         given extents, e.g. NdArray<double,3> x(n,l,m). */
+	template<typename... Extents>
+	explicit NdArray(Extents... extents)
+	{
+		static_assert(sizeof...(Extents)==Rank, "NdArray: number of extents must equal Rank");
+		const size_t e[Rank] = {(size_t) extents...};
+		size_t n = 1;
+
+		for(int d=Rank-1;d>=0;d--)
+		{
+			extent_[d] = e[d];
+			stride_[d] = (ptrdiff_t) n;
+			n *= e[d];
+		}
+		buffer_ = std::shared_ptr<T>((T *) calloc_aligned(n,sizeof(T),ROUTINES_ALIGNMENT), free_aligned);
+		data_   = buffer_.get();
+	}
+
+	/*! \fn T &operator()(Index... index) const
+	 *  \brief Element access, unchecked. */
+	template<typename... Index>
+	T &operator()(Index... index) const
+	{
+		static_assert(sizeof...(Index)==Rank, "NdArray: number of indices must equal Rank");
+		const ptrdiff_t i[Rank] = {(ptrdiff_t) index...};
+		ptrdiff_t offset = 0;
+
+		for(int d=0;d<Rank;d++)
+			offset += i[d]*stride_[d];
+		return data_[offset];
+	}
+
+	/*! \fn size_t extent(int d) const
+	 *  \brief Number of elements along dimension d. */
+	size_t    extent(int d) const { return extent_[d]; }
+
+	/*! \fn ptrdiff_t stride(int d) const
+	 *  \brief Distance in elements between neighbours along dimension d. */
+	ptrdiff_t stride(int d) const { return stride_[d]; }
+
+	/*! \fn T *data() const
+	 *  \brief Pointer to the first element of the array or view. */
+	T        *data() const { return data_; }
+
+	/*! \fn size_t size() const
+	 *  \brief Total number of elements. */
+	size_t size() const
+	{
+		size_t n = 1;
+		for(int d=0;d<Rank;d++)
+			n *= extent_[d];
+		return n;
+	}
+
+	/*! \fn bool is_contiguous() const
+	 *  \brief True if the elements occupy data()[0..size()-1] in row-major
+	 *         order, i.e. the view can be handed to the flat routines. */
+	bool is_contiguous() const
+	{
+		ptrdiff_t n = 1;
+		for(int d=Rank-1;d>=0;d--)
+		{
+			if(extent_[d]!=1 && stride_[d]!=n)
+				return false;
+			n *= (ptrdiff_t) extent_[d];
+		}
+		return true;
+	}
+
+	/*! \fn NdArray<T,Rank-1> slice(int dim, size_t index) const
+	 *  \brief Zero-copy view of the hyperplane at position index along dim. */
+	NdArray<T,Rank-1> slice(int dim, size_t index) const
+	{
+		static_assert(Rank>1, "NdArray: cannot slice a rank 1 array");
+		NdArray<T,Rank-1> v;
+
+		check_index(dim, index, 1, "slice");
+		v.buffer_ = buffer_;
+		v.data_   = data_ + (ptrdiff_t) index*stride_[dim];
+		for(int d=0,k=0;d<Rank;d++)
+		{
+			if(d==dim)
+				continue;
+			v.extent_[k] = extent_[d];
+			v.stride_[k] = stride_[d];
+			k++;
+		}
+		return v;
+	}
+
+	/*! \fn NdArray<T,Rank> transpose(int d0, int d1) const
+	 *  \brief Zero-copy view with dimensions d0 and d1 exchanged. */
+	NdArray<T,Rank> transpose(int d0, int d1) const
+	{
+		NdArray<T,Rank> v = *this;
+
+		check_index(d0, 0, 0, "transpose");
+		check_index(d1, 0, 0, "transpose");
+		v.extent_[d0] = extent_[d1];
+		v.stride_[d0] = stride_[d1];
+		v.extent_[d1] = extent_[d0];
+		v.stride_[d1] = stride_[d0];
+		return v;
+	}
+
+	/*! \fn NdArray<T,Rank> transpose() const
+	 *  \brief Zero-copy view with the order of all dimensions reversed. */
+	NdArray<T,Rank> transpose() const
+	{
+		NdArray<T,Rank> v = *this;
+
+		for(int d=0;d<Rank;d++)
+		{
+			v.extent_[d] = extent_[Rank-1-d];
+			v.stride_[d] = stride_[Rank-1-d];
+		}
+		return v;
+	}
+
+	/*! \fn NdArray<T,Rank> block(const size_t start[], const size_t count[]) const
+	 *  \brief Zero-copy view of the sub-block [start[d], start[d]+count[d])
+	 *         along every dimension d. */
+	NdArray<T,Rank> block(const size_t start[], const size_t count[]) const
+	{
+		NdArray<T,Rank> v = *this;
+
+		for(int d=0;d<Rank;d++)
+		{
+			check_index(d, start[d], count[d], "block");
+			v.data_     += (ptrdiff_t) start[d]*stride_[d];
+			v.extent_[d] = count[d];
+		}
+		return v;
+	}
+
+	/*! \fn void for_each(F f) const
+	 *  \brief Call f(T &) on every element in row-major order of the view. */
+	template<typename F>
+	void for_each(F f) const
+	{
+		size_t i[Rank];
+		size_t n = size();
+
+		if(n==0)
+			return;
+		for(int d=0;d<Rank;d++)
+			i[d] = 0;
+
+		//walk the innermost dimension with a strided loop and
+		//carry the multi-index for the outer ones
+		for(;;)
+		{
+			T *p = data_;
+			for(int d=0;d<Rank-1;d++)
+				p += (ptrdiff_t) i[d]*stride_[d];
+			for(size_t k=0;k<extent_[Rank-1];k++)
+				f(p[(ptrdiff_t) k*stride_[Rank-1]]);
+
+			int d = Rank-2;
+			for(;d>=0;d--)
+			{
+				if(++i[d]<extent_[d])
+					break;
+				i[d] = 0;
+			}
+			if(d<0)
+				return;
+		}
+	}
+
+	private:
+
+	void check_index(int dim, size_t start, size_t count, const char *what) const
+	{
+		if(dim<0 || dim>=Rank || start+count>extent_[dim])
+		{
+			printf("Error: NdArray::%s out of range (dim %d, start %zu, count %zu).\n",what,dim,start,count);
+			fflush(stdout);
+			exit(-1);
+		}
+	}
+
+	std::shared_ptr<T> buffer_;
+	T                 *data_;
+	size_t             extent_[Rank];
+	ptrdiff_t          stride_[Rank];
+};
+
+/*! \fn double array_max(const NdArray<double,Rank> &x)
+ *  \brief Find the maximum of an array or view without copying it. */
+template<int Rank>
+double array_max(const NdArray<double,Rank> &x)
+{
+	if(x.size()==0)
+		return NAN;
+	if(x.is_contiguous())
+		return array_max(x.data(), x.size());
+
+	//same NaN behaviour as gsl_stats_max
+	double m   = x.data()[0];
+	bool   nan = false;
+	x.for_each([&](double v) { if(v>m) m = v; if(isnan(v)) nan = true; });
+	return nan ? NAN : m;
+}
+
+/*! \fn double array_min(const NdArray<double,Rank> &x)
+ *  \brief Find the minimum of an array or view without copying it. */
+template<int Rank>
+double array_min(const NdArray<double,Rank> &x)
+{
+	if(x.size()==0)
+		return NAN;
+	if(x.is_contiguous())
+		return array_min(x.data(), x.size());
+
+	double m   = x.data()[0];
+	bool   nan = false;
+	x.for_each([&](double v) { if(v<m) m = v; if(isnan(v)) nan = true; });
+	return nan ? NAN : m;
+}
+
+/*! \fn double vector_dot_product(const NdArray<double,1> &x, const NdArray<double,1> &y)
+ *  \brief Find the dot product of x * y for vectors or strided views. */
+inline double vector_dot_product(const NdArray<double,1> &x, const NdArray<double,1> &y)
+{
+	if(x.extent(0)!=y.extent(0))
+	{
+		printf("Error: vector_dot_product extents differ (%zu and %zu).\n",x.extent(0),y.extent(0));
+		fflush(stdout);
+		exit(-1);
+	}
+	if(x.stride(0)==1 && y.stride(0)==1)
+		return vector_dot_product(x.data(), y.data(), x.extent(0));
+
+	double    dot = 0;
+	ptrdiff_t sx  = x.stride(0);
+	ptrdiff_t sy  = y.stride(0);
+	for(size_t i=0;i<x.extent(0);i++)
+		dot += x.data()[(ptrdiff_t) i*sx]*y.data()[(ptrdiff_t) i*sy];
+	return dot;
+}
+
+#endif //BRANT_NDARRAY
@@ -3,11 +3,56 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_spline.h>
-#include <gsl/gsl_statistics.h>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <new>
+#include <unordered_map>
 #include "routines.hpp"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+//gcc 12's AVX-512 headers trip -Wmaybe-uninitialized on their own
+//_mm*_undefined_* placeholders (gcc PR 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#define ROUTINES_X86_SIMD
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ROUTINES_NEON_SIMD
+#endif
+
+//error-free transformations are only exact, and the batched kernels
+//only match the single-vector routines, if the compiler does not
+//contract their multiplies and adds into fma; clang has no function
+//attribute for this, so there it is turned off for the whole file
+#if defined(__GNUC__) && !defined(__clang__)
+#define ROUTINES_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+#define ROUTINES_NO_CONTRACT
+#endif
+
 
 /*! \fn double double_log10_index(int i, int n, double xmin, double xmax)
  *  \brief Provides the i^th out of n log10 incremented value between xmin and xmax.
@@ -25,6 +70,79 @@ double double_linear_index(int i, int n, double xmin, double xmax)
 {
 	return (xmax - xmin)*((double) i)/((double) (n-1)) + xmin;
 }
+/*! \def ROUTINES_GRID_BLOCK
+ *  \brief Elements of fill_log10_grid generated from each exactly computed anchor. */
+#define ROUTINES_GRID_BLOCK 64
+/*! \fn void fill_linear_grid(double *x, int n, double xmin, double xmax)
+ *  \brief Fill x with the n values double_linear_index(i,n,xmin,xmax).
+ */
+void fill_linear_grid(double *x, int n, double xmin, double xmax)
+{
+	double dx;
+
+	if(n<1)
+		return;
+	if(n==1)
+	{
+		x[0] = xmin;
+		return;
+	}
+
+	dx = (xmax - xmin)/((double) (n-1));
+	for(int i=0;i<n;i++)
+		x[i] = dx*((double) i) + xmin;
+
+	//remove the rounding at the ends
+	x[0]   = xmin;
+	x[n-1] = xmax;
+}
+/*! \fn void fill_log10_grid(double *x, int n, double xmin, double xmax)
+ *  \brief Fill x with the n values double_log10_index(i,n,xmin,xmax).
+ */
+void fill_log10_grid(double *x, int n, double xmin, double xmax)
+{
+	//the grid is cut into blocks of ROUTINES_GRID_BLOCK;
+	//the first element of each block is found with pow
+	//and the rest as that times a tabulated power of the
+	//ratio, so each element is two roundings from a pow
+	//whatever n is, rather than accumulating n roundings
+	//as a plain recurrence would, and the inner loop is
+	//a vectorizable multiply
+	double r[ROUTINES_GRID_BLOCK];
+	double lmin, dl, anchor;
+	int    m;
+
+	if(n<1)
+		return;
+	if(!(xmin>0) || !(xmax>0))
+	{
+		printf("Error: fill_log10_grid needs xmin > 0 and xmax > 0 (xmin = %e, xmax = %e).\n",xmin,xmax);
+		fflush(stdout);
+		exit(-1);
+	}
+	if(n==1)
+	{
+		x[0] = xmin;
+		return;
+	}
+
+	lmin = log10(xmin);
+	dl   = (log10(xmax) - lmin)/((double) (n-1));
+	m    = GSL_MIN(ROUTINES_GRID_BLOCK,n);
+	for(int k=0;k<m;k++)
+		r[k] = pow(10.0,dl*((double) k));
+
+	for(int i=0;i<n;i+=ROUTINES_GRID_BLOCK)
+	{
+		m      = GSL_MIN(ROUTINES_GRID_BLOCK,n-i);
+		anchor = pow(10.0,dl*((double) i) + lmin);
+		for(int k=0;k<m;k++)
+			x[i+k] = anchor*r[k];
+	}
+
+	x[0]   = xmin;
+	x[n-1] = xmax;
+}
 /*! \fn void check_args(int argc, char **argv, int num_args)
  *  \brief Ensures that the number of command line arguements equals num_args.
  */
@@ -62,84 +180,765 @@ FILE *fopen_brant(char fname[], const char *mode)
 {
 	FILE *fp;
 
-	if(!(fp = fopen(fname,mode)))
+	if(!(fp = try_fopen_brant(fname,mode)))
 	{
-		printf("Error opening %s.\n",fname);
+		printf("Error opening %s (%s).\n",fname,strerror(errno));
 		fflush(stdout);
 		exit(-1);
 	}
 
 	return fp;
 }
-/*! \fn double *calloc_double_array(int n)
+/*! \fn FILE *try_fopen_brant(const char *fname, const char *mode)
+ *  \brief Open a FILE pointer, returning NULL with errno set on failure.
+ */
+FILE *try_fopen_brant(const char *fname, const char *mode)
+{
+	return fopen(fname,mode);
+}
+/* Allocation accounting.  Each tag's counters are atomics, so charging
+   an allocation never takes a lock beyond the one guarding the shard of
+   the pointer registry that remembers what to credit back on release.
+   Tag 0 is "untagged" and the last tag collects any beyond the table. */
+struct alloc_tag_stats
+{
+	char                name[64];
+	std::atomic<size_t> live;
+	std::atomic<size_t> peak;
+	std::atomic<size_t> allocs;
+	std::atomic<size_t> frees;
+};
+struct alloc_entry
+{
+	size_t bytes;
+	int    tag;
+};
+
+#define ROUTINES_ALLOC_SHARDS 16
+
+static std::atomic<bool>   alloc_tracking(false);
+static std::atomic<size_t> alloc_entries(0);
+static std::atomic<size_t> alloc_total_live(0);
+static std::atomic<size_t> alloc_total_peak(0);
+static std::atomic<int>    alloc_ntags(1);
+static alloc_tag_stats     alloc_tags[ROUTINES_ALLOC_TAGS];
+static std::mutex          alloc_tags_lock;
+static std::mutex          alloc_shard_lock[ROUTINES_ALLOC_SHARDS];
+static std::unordered_map<const void *, alloc_entry> alloc_shard[ROUTINES_ALLOC_SHARDS];
+static thread_local const char *alloc_tag_name  = NULL;
+static thread_local bool        alloc_tag_stale = false;
+static thread_local int         alloc_tag_index = 0;
+
+/*! \fn void alloc_tracking_enable(bool enable)
+ *  \brief Turn allocation accounting on or off */
+void alloc_tracking_enable(bool enable)
+{
+	alloc_tracking.store(enable);
+}
+
+/*! \fn const char *alloc_set_tag(const char *tag)
+ *  \brief Set this thread's allocation tag, returning the previous one */
+const char *alloc_set_tag(const char *tag)
+{
+	const char *prev = alloc_tag_name;
+
+	alloc_tag_name  = tag;
+	alloc_tag_stale = true;
+	return prev;
+}
+
+/*! \fn static int alloc_tag_find(const char *tag, bool create)
+ *  \brief Index of tag in the table, adding it if create, or -1. */
+static int alloc_tag_find(const char *tag, bool create)
+{
+	std::lock_guard<std::mutex> guard(alloc_tags_lock);
+	int n = alloc_ntags.load();
+
+	if(!tag)
+		return 0;
+	for(int t=1;t<n;t++)
+		if(!strncmp(alloc_tags[t].name,tag,sizeof(alloc_tags[t].name)-1))
+			return t;
+	if(!create)
+		return -1;
+	if(n==ROUTINES_ALLOC_TAGS)
+		return ROUTINES_ALLOC_TAGS-1;
+	if(n==ROUTINES_ALLOC_TAGS-1)
+		tag = "other";
+	snprintf(alloc_tags[n].name,sizeof(alloc_tags[n].name),"%s",tag);
+	alloc_ntags.store(n+1);
+	return n;
+}
+
+/*! \fn static void alloc_peak_update(std::atomic<size_t> &peak, size_t live)
+ *  \brief Raise peak to live if it is lower. */
+static void alloc_peak_update(std::atomic<size_t> &peak, size_t live)
+{
+	size_t p = peak.load(std::memory_order_relaxed);
+	while(p<live && !peak.compare_exchange_weak(p,live,std::memory_order_relaxed));
+}
+
+/*! \fn static void alloc_record(const void *p, size_t bytes)
+ *  \brief Charge the allocation p of bytes to the current tag. */
+static void alloc_record(const void *p, size_t bytes)
+{
+	const std::memory_order relaxed = std::memory_order_relaxed;
+	int    s = (int) ((((uintptr_t) p)>>6) % ROUTINES_ALLOC_SHARDS);
+	size_t live;
+
+	if(!alloc_tracking.load(relaxed) || !p)
+		return;
+
+	//the tag is looked up once per alloc_set_tag, not per allocation
+	if(alloc_tag_stale)
+	{
+		alloc_tag_index = alloc_tag_find(alloc_tag_name,true);
+		alloc_tag_stale = false;
+	}
+	alloc_tag_stats &t = alloc_tags[alloc_tag_index];
+
+	{
+		std::lock_guard<std::mutex> guard(alloc_shard_lock[s]);
+		std::pair<std::unordered_map<const void *, alloc_entry>::iterator, bool> r;
+		r = alloc_shard[s].insert(std::make_pair(p,alloc_entry()));
+		alloc_entry &e = r.first->second;
+		if(!r.second)
+		{
+			//released with free() rather than free_aligned,
+			//and the address has been handed out again
+			alloc_tags[e.tag].live.fetch_sub(e.bytes,relaxed);
+			alloc_total_live.fetch_sub(e.bytes,relaxed);
+		}else
+			alloc_entries.fetch_add(1,relaxed);
+		e.bytes = bytes;
+		e.tag   = alloc_tag_index;
+	}
+
+	t.allocs.fetch_add(1,relaxed);
+	live = t.live.fetch_add(bytes,relaxed) + bytes;
+	alloc_peak_update(t.peak,live);
+	live = alloc_total_live.fetch_add(bytes,relaxed) + bytes;
+	alloc_peak_update(alloc_total_peak,live);
+}
+
+/*! \fn static void alloc_release(const void *p)
+ *  \brief Credit back the allocation p, if it was charged. */
+static void alloc_release(const void *p)
+{
+	const std::memory_order relaxed = std::memory_order_relaxed;
+	int         s = (int) ((((uintptr_t) p)>>6) % ROUTINES_ALLOC_SHARDS);
+	alloc_entry e;
+
+	//entries made while tracking was on are released even after it is
+	//turned off, so the registry cannot go stale
+	if(alloc_entries.load(relaxed)==0 || !p)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(alloc_shard_lock[s]);
+		std::unordered_map<const void *, alloc_entry>::iterator it = alloc_shard[s].find(p);
+		if(it==alloc_shard[s].end())
+			return;
+		e = it->second;
+		alloc_shard[s].erase(it);
+		alloc_entries.fetch_sub(1,relaxed);
+	}
+	alloc_tags[e.tag].frees.fetch_add(1,relaxed);
+	alloc_tags[e.tag].live.fetch_sub(e.bytes,relaxed);
+	alloc_total_live.fetch_sub(e.bytes,relaxed);
+}
+
+/*! \fn size_t alloc_live_bytes(const char *tag)
+ *  \brief Bytes currently allocated under tag, or all tags if NULL */
+size_t alloc_live_bytes(const char *tag)
+{
+	int t;
+
+	if(!tag)
+		return alloc_total_live.load();
+	t = alloc_tag_find(tag,false);
+	return t<0 ? 0 : alloc_tags[t].live.load();
+}
+
+/*! \fn size_t alloc_peak_bytes(const char *tag)
+ *  \brief High-water mark of alloc_live_bytes(tag) */
+size_t alloc_peak_bytes(const char *tag)
+{
+	int t;
+
+	if(!tag)
+		return alloc_total_peak.load();
+	t = alloc_tag_find(tag,false);
+	return t<0 ? 0 : alloc_tags[t].peak.load();
+}
+
+/*! \fn static int alloc_compare_peak(const void *a, const void *b)
+ *  \brief Order tag indices by decreasing peak bytes, for qsort. */
+static int alloc_compare_peak(const void *a, const void *b)
+{
+	size_t pa = alloc_tags[*(const int *) a].peak.load();
+	size_t pb = alloc_tags[*(const int *) b].peak.load();
+
+	return (pa<pb) - (pa>pb);
+}
+
+/*! \fn void alloc_report(FILE *fp, int top)
+ *  \brief Print the top tags by peak bytes */
+void alloc_report(FILE *fp, int top)
+{
+	int order[ROUTINES_ALLOC_TAGS];
+	int n = alloc_ntags.load();
+
+	snprintf(alloc_tags[0].name,sizeof(alloc_tags[0].name),"untagged");
+	for(int t=0;t<n;t++)
+		order[t] = t;
+	qsort(order,n,sizeof(int),alloc_compare_peak);
+
+	fprintf(fp,"%-32s %14s %14s %10s %10s\n","allocation tag","live [bytes]","peak [bytes]","allocs","unfreed");
+	for(int k=0;k<n && k<top;k++)
+	{
+		alloc_tag_stats &t = alloc_tags[order[k]];
+		size_t a = t.allocs.load(), f = t.frees.load();
+
+		if(a==0)
+			continue;
+		fprintf(fp,"%-32s %14zu %14zu %10zu %10zu\n",t.name,t.live.load(),t.peak.load(),a,a-f);
+	}
+	fprintf(fp,"%-32s %14zu %14zu\n","total",alloc_total_live.load(),alloc_total_peak.load());
+	fflush(fp);
+}
+
+/* Big slabs are mapped directly: their pages are zero and untouched
+   until used, so a NUMA policy can still place them, and they can be
+   aligned to and backed by huge pages.  free_aligned finds them again
+   here.  Programs that map none pay one load per free_aligned. */
+static std::mutex                          pages_lock;
+static std::unordered_map<void *, size_t>  pages_maps;
+static std::atomic<size_t>                 pages_count(0);
+static std::atomic<int>                    huge_mode(HUGE_PAGES_TRANSPARENT);
+static std::atomic<size_t>                 huge_threshold(ROUTINES_HUGE_PAGE_THRESHOLD);
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+/*! \def ROUTINES_HUGE_PAGE
+ *  \brief Size of a transparent huge page on x86-64 and arm64 (4 KB granule). */
+#define ROUTINES_HUGE_PAGE ((size_t) 2097152)
+
+/*! \fn void huge_pages_set(huge_page_mode mode, size_t threshold)
+ *  \brief Choose the pages used for allocations of threshold bytes or more */
+void huge_pages_set(huge_page_mode mode, size_t threshold)
+{
+	huge_mode.store(mode);
+	huge_threshold.store(threshold);
+}
+
+/*! \fn static bool huge_pages_wanted(size_t nbytes)
+ *  \brief True if an allocation of nbytes should use huge pages. */
+static bool huge_pages_wanted(size_t nbytes)
+{
+	return huge_mode.load(std::memory_order_relaxed)!=HUGE_PAGES_NONE && nbytes>=huge_threshold.load(std::memory_order_relaxed);
+}
+
+/*! \fn static void *alloc_failed(bool fatal, int err, const char *format, ...)
+ *  \brief Report a failed allocation: print the message and exit if
+ *         fatal, as the aborting routines do, or else set errno to err
+ *         and return NULL for the try_* routines. */
+static void *alloc_failed(bool fatal, int err, const char *format, ...)
+{
+	va_list args;
+
+	if(fatal)
+	{
+		va_start(args,format);
+		vprintf(format,args);
+		va_end(args);
+		fflush(stdout);
+		exit(-1);
+	}
+	errno = err;
+	return NULL;
+}
+
+/*! \fn static bool extent_multiply(size_t a, size_t b, size_t *ab)
+ *  \brief Set *ab = a*b for array extents or sizes, returning false
+ *         instead if the product is past half of size_t, which is more
+ *         than any address space and so can only be an overflow. */
+static bool extent_multiply(size_t a, size_t b, size_t *ab)
+{
+	if(b && a>((size_t) -1)/2/b)
+		return false;
+	*ab = a*b;
+	return true;
+}
+
+/*! \fn static size_t extent_product(size_t a, size_t b)
+ *  \brief a*b as extent_multiply, exiting with the usual allocation
+ *         error on overflow. */
+static size_t extent_product(size_t a, size_t b)
+{
+	size_t ab;
+
+	if(!extent_multiply(a,b,&ab))
+	{
+		printf("Error allocating array of %zu elements of size %zu (overflow).\n",a,b);
+		fflush(stdout);
+		exit(-1);
+	}
+	return ab;
+}
+
+/*! \fn static void *pages_map(size_t nbytes, bool fatal)
+ *  \brief Map nbytes of fresh, zero, untouched anonymous pages, backed
+ *         by huge pages if huge_pages_wanted and then aligned to 2 MB. */
+static void *pages_map(size_t nbytes, bool fatal)
+{
+	int     mode = huge_mode.load(std::memory_order_relaxed);
+	bool    huge = huge_pages_wanted(nbytes);
+	char   *p    = (char *) MAP_FAILED;
+	size_t  len  = nbytes;
+
+	//larger requests would wrap when rounded up to a page
+	if(nbytes>((size_t) -1)/2)
+		return alloc_failed(fatal,ENOMEM,"Error mapping %zu bytes.\n",nbytes);
+
+#ifdef MAP_HUGETLB
+	//explicit huge pages come from the vm.nr_hugepages pool,
+	//which is usually empty, so failure here is expected
+	if(huge && (mode==HUGE_PAGES_2MB || mode==HUGE_PAGES_1GB))
+	{
+		size_t page = (mode==HUGE_PAGES_1GB) ? ((size_t) 1)<<30 : ROUTINES_HUGE_PAGE;
+		len = (nbytes + page-1)/page*page;
+		p   = (char *) mmap(NULL,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|(mode==HUGE_PAGES_1GB ? MAP_HUGE_1GB : MAP_HUGE_2MB),-1,0);
+	}
+#else
+	(void) mode;
+#endif
+	if(p==(char *) MAP_FAILED && huge)
+	{
+		//over-map by one huge page and trim to a 2 MB aligned
+		//range, which the kernel can back with transparent ones
+		len = (nbytes + ROUTINES_HUGE_PAGE-1)/ROUTINES_HUGE_PAGE*ROUTINES_HUGE_PAGE;
+		p   = (char *) mmap(NULL,len+ROUTINES_HUGE_PAGE,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+		if(p!=(char *) MAP_FAILED)
+		{
+			size_t head = (ROUTINES_HUGE_PAGE - ((uintptr_t) p) % ROUTINES_HUGE_PAGE) % ROUTINES_HUGE_PAGE;
+			if(head)
+				munmap(p,head);
+			if(ROUTINES_HUGE_PAGE-head)
+				munmap(p+head+len,ROUTINES_HUGE_PAGE-head);
+			p += head;
+#ifdef MADV_HUGEPAGE
+			madvise(p,len,MADV_HUGEPAGE);
+#endif
+		}
+	}
+	if(p==(char *) MAP_FAILED && !huge)
+		p = (char *) mmap(NULL,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	if(p==(char *) MAP_FAILED)
+		return alloc_failed(fatal,ENOMEM,"Error mapping %zu bytes.\n",nbytes);
+	std::lock_guard<std::mutex> guard(pages_lock);
+	pages_maps[p] = len;
+	pages_count++;
+	return p;
+}
+
+/*! \fn static bool pages_unmap(void *p)
+ *  \brief Unmap p and return true if it came from pages_map. */
+static bool pages_unmap(void *p)
+{
+	size_t nbytes;
+
+	if(pages_count.load(std::memory_order_relaxed)==0)
+		return false;
+	{
+		std::lock_guard<std::mutex> guard(pages_lock);
+		std::unordered_map<void *, size_t>::iterator it = pages_maps.find(p);
+		if(it==pages_maps.end())
+			return false;
+		nbytes = it->second;
+		pages_maps.erase(it);
+		pages_count--;
+	}
+	munmap(p,nbytes);
+	return true;
+}
+
+/*! \fn static void *calloc_array(size_t n, size_t size)
+ *  \brief calloc, with the 2 MB aligned interior of huge_pages_wanted
+ *         allocations advised to use transparent huge pages.  glibc
+ *         serves such blocks from fresh mmap pages, which are already
+ *         zero, so nothing is touched here and each page is placed on
+ *         the node of the thread that first writes it. */
+static void *calloc_array(size_t n, size_t size)
+{
+	void   *f;
+
+	//half of size_t is more than any address space, and keeps the
+	//rounding to a huge page below from wrapping
+	if(size && n>((size_t) -1)/2/size)
+		return alloc_failed(false,ENOMEM,NULL);
+	if(!(f = calloc(n,size)))
+		return alloc_failed(false,ENOMEM,NULL);
+
+#ifdef MADV_HUGEPAGE
+	if(huge_pages_wanted(n*size))
+	{
+		uintptr_t head = ((uintptr_t) f + ROUTINES_HUGE_PAGE-1)/ROUTINES_HUGE_PAGE*ROUTINES_HUGE_PAGE;
+		uintptr_t tail = ((uintptr_t) f + n*size)/ROUTINES_HUGE_PAGE*ROUTINES_HUGE_PAGE;
+		if(tail>head)
+			madvise((void *) head,tail-head,MADV_HUGEPAGE);
+	}
+#endif
+	return f;
+}
+
+/*! \fn double *calloc_double_array(size_t n)
  *  \brief Safe method for callocing a double array
  */
-double *calloc_double_array(int n)
+double *calloc_double_array(size_t n)
 {
 	double *f;
 
-	if(!(f = (double *) calloc(n,sizeof(double))))
+	if(!(f = try_calloc_double_array(n)))
 	{
-		printf("Error allocating array of size %d (%d).\n",n,(int) (n*sizeof(double)/sizeof(int)));
+		printf("Error allocating array of size %zu (%zu bytes).\n",n,n*sizeof(double));
 		fflush(stdout);
 		exit(-1);
 	}
 
 	return f;
 }
+/*! \fn double *try_calloc_double_array(size_t n)
+ *  \brief calloc a double array, returning NULL with errno set on failure
+ */
+double *try_calloc_double_array(size_t n)
+{
+	double *f;
+
+	if((f = (double *) calloc_array(n,sizeof(double))))
+		alloc_record(f,n*sizeof(double));
+	return f;
+}
 
 
-/*! \fn float *calloc_float_array(int n)
+/*! \fn float *calloc_float_array(size_t n)
  *  \brief Safe method for callocing a float array
  */
-float *calloc_float_array(int n)
+float *calloc_float_array(size_t n)
 {
 	float *f;
 
-	if(!(f = (float *) calloc(n,sizeof(float))))
+	if(!(f = try_calloc_float_array(n)))
 	{
-		printf("Error allocating array of size %d (%d).\n",n,(int) (n*sizeof(float)/sizeof(int)));
+		printf("Error allocating array of size %zu (%zu bytes).\n",n,n*sizeof(float));
 		fflush(stdout);
 		exit(-1);
 	}
 
 	return f;
 }
+/*! \fn float *try_calloc_float_array(size_t n)
+ *  \brief calloc a float array, returning NULL with errno set on failure
+ */
+float *try_calloc_float_array(size_t n)
+{
+	float *f;
+
+	if((f = (float *) calloc_array(n,sizeof(float))))
+		alloc_record(f,n*sizeof(float));
+	return f;
+}
 
 
-/*! \fn int *calloc_int_array(int n)
+/*! \fn int *calloc_int_array(size_t n)
  *  \brief Safe method for callocing an int array
  */
-int *calloc_int_array(int n)
+int *calloc_int_array(size_t n)
 {
 	int *f;
 
-	if(!(f = (int *) calloc(n,sizeof(int))))
+	if(!(f = try_calloc_int_array(n)))
 	{
-		printf("Error allocating array of size %d (%d).\n",n,(int) (n*sizeof(int)/sizeof(int)));
+		printf("Error allocating array of size %zu (%zu bytes).\n",n,n*sizeof(int));
 		fflush(stdout);
 		exit(-1);
 	}
 
 	return f;
 }
+/*! \fn int *try_calloc_int_array(size_t n)
+ *  \brief calloc an int array, returning NULL with errno set on failure
+ */
+int *try_calloc_int_array(size_t n)
+{
+	int *f;
+
+	if((f = (int *) calloc_array(n,sizeof(int))))
+		alloc_record(f,n*sizeof(int));
+	return f;
+}
 
-/*! \fn size_t *calloc_size_t_array(int n)
+/*! \fn size_t *calloc_size_t_array(size_t n)
  *  \brief Safe method for callocing a size_t array
  */
-size_t *calloc_size_t_array(int n)
+size_t *calloc_size_t_array(size_t n)
 {
 	size_t *f;
 
-	if(!(f = (size_t *) calloc(n,sizeof(size_t))))
+	if(!(f = try_calloc_size_t_array(n)))
 	{
-		printf("Error allocating array of size %d (%d).\n",n,(int) (n*sizeof(size_t)/sizeof(int)));
+		printf("Error allocating array of size %zu (%zu bytes).\n",n,n*sizeof(size_t));
 		fflush(stdout);
 		exit(-1);
 	}
 
 	return f;
 }
+/*! \fn size_t *try_calloc_size_t_array(size_t n)
+ *  \brief calloc a size_t array, returning NULL with errno set on failure
+ */
+size_t *try_calloc_size_t_array(size_t n)
+{
+	size_t *f;
+
+	if((f = (size_t *) calloc_array(n,sizeof(size_t))))
+		alloc_record(f,n*sizeof(size_t));
+	return f;
+}
+/*! \fn static void *aligned_slab(size_t n, size_t size, size_t alignment, bool zero, bool fatal)
+ *  \brief Aligned array of n elements of size bytes, zeroed if zero.
+ *         Failures exit if fatal and return NULL otherwise. */
+static void *aligned_slab(size_t n, size_t size, size_t alignment, bool zero, bool fatal)
+{
+	void   *f;
+	size_t  nbytes;
+
+	if(alignment<sizeof(void *) || alignment>ROUTINES_MAX_ALIGNMENT || (alignment & (alignment-1)))
+		return alloc_failed(fatal,EINVAL,"Error: alignment %zu must be a power of two between %zu and %d.\n",alignment,sizeof(void *),ROUTINES_MAX_ALIGNMENT);
+
+	if(size && n>((size_t) -1)/2/size)
+		return alloc_failed(fatal,ENOMEM,"Error allocating array of %zu elements of size %zu (overflow).\n",n,size);
+
+	//always ask for at least one byte so success is never NULL
+	nbytes = n*size;
+	if(nbytes==0)
+		nbytes = 1;
+
+	//big slabs get fresh pages, which are already zero and cost
+	//nothing to leave uninitialized
+	if(huge_pages_wanted(nbytes))
+	{
+		if((f = pages_map(nbytes,fatal)))
+			alloc_record(f,n*size);
+		return f;
+	}
+
+	if(posix_memalign(&f,alignment,nbytes))
+		return alloc_failed(fatal,ENOMEM,"Error allocating aligned array of size %zu (%zu bytes, alignment %zu).\n",n,nbytes,alignment);
+	if(zero)
+		memset(f,0,nbytes);
+	alloc_record(f,n*size);
+
+	return f;
+}
+/*! \fn void *calloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief Safe method for allocating a zeroed, aligned array of n
+ *         elements of size bytes.
+ */
+void *calloc_aligned(size_t n, size_t size, size_t alignment)
+{
+	return aligned_slab(n,size,alignment,true,true);
+}
+/*! \fn void *malloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief Safe method for allocating an uninitialized, aligned array of
+ *         n elements of size bytes.
+ */
+void *malloc_aligned(size_t n, size_t size, size_t alignment)
+{
+	return aligned_slab(n,size,alignment,false,true);
+}
+/*! \fn void *try_calloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief As calloc_aligned, returning NULL with errno set on failure.
+ */
+void *try_calloc_aligned(size_t n, size_t size, size_t alignment)
+{
+	return aligned_slab(n,size,alignment,true,false);
+}
+/*! \fn void *try_malloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief As malloc_aligned, returning NULL with errno set on failure.
+ */
+void *try_malloc_aligned(size_t n, size_t size, size_t alignment)
+{
+	return aligned_slab(n,size,alignment,false,false);
+}
+/*! \def ROUTINES_NUMA_MAX_NODES
+ *  \brief Nodes representable in the mbind node mask. */
+#define ROUTINES_NUMA_MAX_NODES 1024
+//from <numaif.h>, which needs libnuma's headers
+#define ROUTINES_MPOL_BIND       2
+#define ROUTINES_MPOL_INTERLEAVE 3
+
+/*! \fn static int numa_nodes(void)
+ *  \brief Number of possible NUMA nodes, from sysfs; 1 if unknown. */
+static int numa_nodes(void)
+{
+	static int nodes = 0;
+	FILE      *fp;
+	int        lo, hi;
+
+	if(nodes)
+		return nodes;
+	nodes = 1;
+	//"0" or "0-1"
+	if((fp = fopen("/sys/devices/system/node/possible","r")))
+	{
+		int k = fscanf(fp,"%d-%d",&lo,&hi);
+		if(k==2 && hi>=0 && hi<ROUTINES_NUMA_MAX_NODES)
+			nodes = hi+1;
+		fclose(fp);
+	}
+	return nodes;
+}
+
+/*! \fn static void numa_place(void *p, size_t nbytes, numa_placement placement, int node)
+ *  \brief Set the interleave or bind policy of the untouched pages p. */
+static void numa_place(void *p, size_t nbytes, numa_placement placement, int node)
+{
+	const int     bits = 8*sizeof(unsigned long);
+	unsigned long mask[ROUTINES_NUMA_MAX_NODES/(8*sizeof(unsigned long))];
+	int           nodes = numa_nodes();
+	int           mode;
+
+	memset(mask,0,sizeof(mask));
+	if(placement==NUMA_INTERLEAVE)
+	{
+		mode = ROUTINES_MPOL_INTERLEAVE;
+		for(int k=0;k<nodes;k++)
+			mask[k/bits] |= 1UL<<(k%bits);
+	}else{
+		if(node<0 || node>=nodes)
+		{
+			printf("Error: NUMA node %d must be between 0 and %d.\n",node,nodes-1);
+			fflush(stdout);
+			exit(-1);
+		}
+		mode = ROUTINES_MPOL_BIND;
+		mask[node/bits] |= 1UL<<(node%bits);
+	}
+#ifdef SYS_mbind
+	//a refusal leaves the default, first touch policy
+	syscall(SYS_mbind,p,nbytes,mode,mask,(unsigned long) nodes+1,0UL);
+#else
+	(void) p;
+	(void) nbytes;
+	(void) mode;
+#endif
+}
+
+/*! \fn static void numa_first_touch(char *p, size_t nrows, size_t row_bytes)
+ *  \brief Fault in the pages of nrows rows of row_bytes each from the
+ *         thread that schedule(static) gives the row the page starts in. */
+static void numa_first_touch(char *p, size_t nrows, size_t row_bytes)
+{
+	const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+	#pragma omp parallel
+	{
+		size_t tid = 0, nt = 1;
+#ifdef _OPENMP
+		tid = omp_get_thread_num();
+		nt  = omp_get_num_threads();
+#endif
+		//the split schedule(static) makes: the first nrows%nt
+		//threads take one row more than the rest
+		size_t q  = nrows/nt, r = nrows%nt;
+		size_t lo = tid*q + GSL_MIN(tid,r);
+		size_t hi = lo + q + (tid<r ? 1 : 0);
+		size_t a  = (lo*row_bytes + page-1)/page*page;
+
+		//the pages are already zero; writing a zero faults them in
+		for(size_t c=a;c<hi*row_bytes;c+=page)
+			((volatile char *) p)[c] = 0;
+	}
+}
+
+/*! \fn static void *numa_slab(size_t nrows, size_t row_bytes, numa_placement placement, int node)
+ *  \brief Zeroed slab of nrows rows of row_bytes with placed pages. */
+static void *numa_slab(size_t nrows, size_t row_bytes, numa_placement placement, int node)
+{
+	void   *p;
+	size_t  nbytes;
+
+	if(row_bytes && nrows>((size_t) -1)/row_bytes)
+	{
+		printf("Error allocating array of %zu elements of size %zu (overflow).\n",nrows,row_bytes);
+		fflush(stdout);
+		exit(-1);
+	}
+	nbytes = nrows*row_bytes;
+	if(nbytes<ROUTINES_NUMA_MIN_BYTES)
+		return calloc_aligned(nrows,row_bytes,ROUTINES_ALIGNMENT);
+
+	p = pages_map(nbytes,true);
+	if(placement==NUMA_FIRST_TOUCH)
+		numa_first_touch((char *) p,nrows,row_bytes);
+	else
+		numa_place(p,nbytes,placement,node);
+	alloc_record(p,nbytes);
+	return p;
+}
+
+/*! \fn void *calloc_numa(size_t n, size_t size, numa_placement placement, int node)
+ *  \brief Allocate a zeroed array of n elements of size bytes with its
+ *         pages placed as placement asks.
+ */
+void *calloc_numa(size_t n, size_t size, numa_placement placement, int node)
+{
+	return numa_slab(n,size,placement,node);
+}
+/*! \fn void free_aligned(void *p)
+ *  \brief Release memory from calloc_aligned.
+ */
+void free_aligned(void *p)
+{
+	alloc_release(p);
+	if(!pages_unmap(p))
+		free(p);
+}
+/*! \fn double *calloc_aligned_double_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned double array
+ */
+double *calloc_aligned_double_array(size_t n, size_t alignment)
+{
+	return (double *) calloc_aligned(n,sizeof(double),alignment);
+}
+/*! \fn float *calloc_aligned_float_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned float array
+ */
+float *calloc_aligned_float_array(size_t n, size_t alignment)
+{
+	return (float *) calloc_aligned(n,sizeof(float),alignment);
+}
+/*! \fn int *calloc_aligned_int_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned int array
+ */
+int *calloc_aligned_int_array(size_t n, size_t alignment)
+{
+	return (int *) calloc_aligned(n,sizeof(int),alignment);
+}
+/*! \fn size_t *calloc_aligned_size_t_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned size_t array
+ */
+size_t *calloc_aligned_size_t_array(size_t n, size_t alignment)
+{
+	return (size_t *) calloc_aligned(n,sizeof(size_t),alignment);
+}
 /*! \fn double max_three(double a, double b, double c)
  *  \brief Returns the max of 3 numbers */
 double max_three(double a, double b, double c)
@@ -147,96 +946,129 @@ double max_three(double a, double b, double c)
 	return GSL_MAX_DBL(GSL_MAX_DBL(a,b),c);
 }
 
-/*! \fn double **two_dimensional_array(int n, int l)
+/*! \fn static void array_fill(T *x, size_t n, array_init init, T value)
+ *  \brief Initialize the n elements of x as init asks. */
+template<typename T>
+static void array_fill(T *x, size_t n, array_init init, T value)
+{
+	if(init==ARRAY_ZEROED)
+		memset(x,0,n*sizeof(T));
+	else if(init==ARRAY_FILLED)
+		for(size_t i=0;i<n;i++)
+			x[i] = value;
+}
+/*! \fn static T *array_slab(size_t n, array_init init, T value, bool fatal)
+ *  \brief Slab of n elements aligned to ROUTINES_ALIGNMENT and initialized
+ *         as init asks; zeroed slabs take calloc_aligned's zero pages.
+ *         Failures exit if fatal and return NULL otherwise. */
+template<typename T>
+static T *array_slab(size_t n, array_init init, T value, bool fatal = true)
+{
+	T *x = (T *) aligned_slab(n,sizeof(T),ROUTINES_ALIGNMENT,init==ARRAY_ZEROED,fatal);
+
+	if(x && init!=ARRAY_ZEROED)
+		array_fill(x,n,init,value);
+	return x;
+}
+
+/*! \fn double **two_dimensional_array(size_t n, size_t l, array_init init, double value)
  *  \brief Allocate a two dimensional (n x l) array
  */
-double **two_dimensional_array(int n, int l)
+double **two_dimensional_array(size_t n, size_t l, array_init init, double value)
 {
 	double **x;
 
+	//each row is initialized as it is allocated, while in cache
 	x = new double *[n];
-	for(int i=0;i<n;i++)
+	for(size_t i=0;i<n;i++)
+	{
 		x[i] = new double[l];
-
-	for(int i=0;i<n;i++)
-		for(int j=0;j<l;j++)
-			x[i][j] = 0.0;
+		array_fill(x[i],l,init,value);
+	}
+	alloc_record(x,n*(sizeof(double *) + l*sizeof(double)));
 	return x;
 }
-/*! \fn void deallocate_two_dimensional_array(double **x, int n, int l)
+/*! \fn void deallocate_two_dimensional_array(double **x, size_t n, size_t l)
  *  \brief De-allocate a two dimensional (n x l) array
  */
-void deallocate_two_dimensional_array(double **x, int n, int l)
+void deallocate_two_dimensional_array(double **x, size_t n, size_t l)
 {
-	for(int i=0;i<n;i++)
+	alloc_release(x);
+	for(size_t i=0;i<n;i++)
 		delete[] x[i];
 	delete x;
 }
-/*! \fn double ***three_dimensional_array(int n, int l, int m)
+/*! \fn double ***three_dimensional_array(size_t n, size_t l, size_t m, array_init init, double value)
  *  \brief Allocate a three dimensional (n x l x m) array 
  */
-double ***three_dimensional_array(int n, int l, int m)
+double ***three_dimensional_array(size_t n, size_t l, size_t m, array_init init, double value)
 {
 	double ***x;
 
 	x = new double **[n];
-	for(int i=0;i<n;i++)
+	for(size_t i=0;i<n;i++)
 	{
 		x[i] = new double *[l];
-		for(int j=0;j<l;j++)
+		for(size_t j=0;j<l;j++)
 		{
 			x[i][j] = new double [m];
+			array_fill(x[i][j],m,init,value);
 		}
 	}
+	alloc_record(x,n*(sizeof(double **) + l*(sizeof(double *) + m*sizeof(double))));
 
 	return x;
 }
-/*! \fn void deallocate_three_dimensional_array(double ***x, int n, int l, int m)
+/*! \fn void deallocate_three_dimensional_array(double ***x, size_t n, size_t l, size_t m)
  *  \brief De-allocate a three dimensional (n x l x m) array
  */
-void deallocate_three_dimensional_array(double ***x, int n, int l, int m)
+void deallocate_three_dimensional_array(double ***x, size_t n, size_t l, size_t m)
 {
-	for(int i=0;i<n;i++)
+	alloc_release(x);
+	for(size_t i=0;i<n;i++)
 	{
-		for(int j=0;j<l;j++)
+		for(size_t j=0;j<l;j++)
 			delete[] x[i][j];
 		delete[] x[i];
 	}
 	delete x;
 }
-/*! \fn double ***four_dimensional_array(int n, int l, int m, int k)
- *  \brief Allocate a four dimensional (n x l x m x k) array 
+/*! \fn double ****four_dimensional_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+ *  \brief Allocate a four dimensional (n x l x m x p) array 
  */
-double ****four_dimensional_array(int n, int l, int m, int p)
+double ****four_dimensional_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
 {
 	double ****x;
 
 	x = new double ***[n];
-	for(int i=0;i<n;i++)
+	for(size_t i=0;i<n;i++)
 	{
 		x[i] = new double **[l];
-		for(int j=0;j<l;j++)
+		for(size_t j=0;j<l;j++)
 		{
 			x[i][j] = new double *[m];
-			for(int k=0;k<p;k++)
+			for(size_t k=0;k<m;k++)
 			{
 				x[i][j][k] = new double [p];
+				array_fill(x[i][j][k],p,init,value);
 			}
 		}
 	}
+	alloc_record(x,n*(sizeof(double ***) + l*(sizeof(double **) + m*(sizeof(double *) + p*sizeof(double)))));
 
 	return x;
 }
-/*! \fn void deallocate_four_dimensional_array(double ****x, int n, int l, int m, int p)
+/*! \fn void deallocate_four_dimensional_array(double ****x, size_t n, size_t l, size_t m, size_t p)
  *  \brief De-allocate a four dimensional (n x l x m x p) array
  */
-void deallocate_four_dimensional_array(double ****x, int n, int l, int m, int p)
+void deallocate_four_dimensional_array(double ****x, size_t n, size_t l, size_t m, size_t p)
 {
-	for(int i=0;i<n;i++)
+	alloc_release(x);
+	for(size_t i=0;i<n;i++)
 	{
-		for(int j=0;j<l;j++)
+		for(size_t j=0;j<l;j++)
 		{
-			for(int k=0;k<p;k++)
+			for(size_t k=0;k<m;k++)
 				delete[] x[i][j][k];
 			delete[] x[i][j];
 		}
@@ -246,33 +1078,36 @@ void deallocate_four_dimensional_array(double ****x, int n, int l, int m, int p)
 }
 
 
-/*! \fn int ***three_dimensional_int_array(int n, int l, int m)
+/*! \fn int ***three_dimensional_int_array(size_t n, size_t l, size_t m, array_init init, int value)
  *  \brief Allocate a three dimensional (n x l x m) int array
  */
-int ***three_dimensional_int_array(int n, int l, int m)
+int ***three_dimensional_int_array(size_t n, size_t l, size_t m, array_init init, int value)
 {
 	int ***x;
 
 	x = new int **[n];
-	for(int i=0;i<n;i++)
+	for(size_t i=0;i<n;i++)
 	{
 		x[i] = new int *[l];
-		for(int j=0;j<l;j++)
+		for(size_t j=0;j<l;j++)
 		{
 			x[i][j] = new int [m];
+			array_fill(x[i][j],m,init,value);
 		}
 	}
+	alloc_record(x,n*(sizeof(int **) + l*(sizeof(int *) + m*sizeof(int))));
 
 	return x;
 }
-/*! \fn void deallocate_three_int_dimensional_array(int ***x, int n, int l, int m)
+/*! \fn void deallocate_three_dimensional_int_array(int ***x, size_t n, size_t l, size_t m)
  *  \brief De-allocate a three dimensional (n x l x m) int array.
  */
-void deallocate_three_int_dimensional_array(int ***x, int n, int l, int m)
+void deallocate_three_dimensional_int_array(int ***x, size_t n, size_t l, size_t m)
 {
-	for(int i=0;i<n;i++)
+	alloc_release(x);
+	for(size_t i=0;i<n;i++)
 	{
-		for(int j=0;j<l;j++)
+		for(size_t j=0;j<l;j++)
 			delete[] x[i][j];
 		delete[] x[i];
 	}
@@ -280,198 +1115,4532 @@ void deallocate_three_int_dimensional_array(int ***x, int n, int l, int m)
 }
 
 
-/*! \fn int compare_doubles(const void *a, const void *b)
- *  \brief Function to compare doubles, for use with qsort.
+/*! \fn static T **contiguous_array_2d(size_t n, size_t l, array_init init, T value)
+ *  \brief Body of the two dimensional contiguous allocators: a table of n
+ *         row pointers into one slab, or NULL with errno set on failure. */
+template<typename T>
+static T **contiguous_array_2d(size_t n, size_t l, array_init init, T value)
+{
+	T      **x;
+	T       *data;
+	size_t   nl;
+	size_t   table;
+
+	//a pointer table past half of size_t would throw from new[]
+	if(!extent_multiply(n,l,&nl) || !extent_multiply(n,sizeof(T *),&table))
+		return (T **) alloc_failed(false,ENOMEM,NULL);
+
+	//one slab for the data, one table of row pointers into it
+	if(!(x = new(std::nothrow) T *[n]))
+		return (T **) alloc_failed(false,ENOMEM,NULL);
+	if(!(data = array_slab(nl,init,value,false)))
+	{
+		delete[] x;
+		return NULL;
+	}
+	for(size_t i=0;i<n;i++)
+		x[i] = data + i*l;
+
+	if(n==0)
+		free_aligned(data);
+
+	//the slab is charged by aligned_slab, the table here
+	alloc_record(x,n*sizeof(T *));
+	return x;
+}
+/*! \fn static T ***contiguous_array_3d(size_t n, size_t l, size_t m, array_init init, T value)
+ *  \brief Body of the three dimensional contiguous allocators, three
+ *         allocations in total, or NULL with errno set on failure. */
+template<typename T>
+static T ***contiguous_array_3d(size_t n, size_t l, size_t m, array_init init, T value)
+{
+	T     ***x;
+	T      **rows;
+	T       *data;
+	size_t   nl;
+	size_t   nlm;
+	size_t   table;
+
+	if(!extent_multiply(n,l,&nl) || !extent_multiply(nl,m,&nlm) || !extent_multiply(nl,sizeof(T *),&table) || !extent_multiply(n,sizeof(T **),&table))
+		return (T ***) alloc_failed(false,ENOMEM,NULL);
+
+	if(!(x = new(std::nothrow) T **[n]))
+		return (T ***) alloc_failed(false,ENOMEM,NULL);
+	if(!(rows = new(std::nothrow) T *[nl]))
+	{
+		delete[] x;
+		return (T ***) alloc_failed(false,ENOMEM,NULL);
+	}
+	if(!(data = array_slab(nl*m,init,value,false)))
+	{
+		delete[] rows;
+		delete[] x;
+		return NULL;
+	}
+
+	for(size_t j=0;j<nl;j++)
+		rows[j] = data + j*m;
+	for(size_t i=0;i<n;i++)
+		x[i] = rows + i*l;
+
+	//no row points at the slab if l==0, so release it here
+	if(nl==0)
+		free_aligned(data);
+	if(n==0)
+		delete[] rows;
+
+	alloc_record(x,n*sizeof(T **) + nl*sizeof(T *));
+	return x;
+}
+
+/*! \fn static T ****contiguous_array_4d(size_t n, size_t l, size_t m, size_t p, array_init init, T value)
+ *  \brief Body of the four dimensional contiguous allocator, four
+ *         allocations in total, or NULL with errno set on failure. */
+template<typename T>
+static T ****contiguous_array_4d(size_t n, size_t l, size_t m, size_t p, array_init init, T value)
+{
+	T    ****x;
+	T     ***planes;
+	T      **rows;
+	T       *data;
+	size_t   nl;
+	size_t   nlm;
+	size_t   nlmp;
+	size_t   table;
+
+	if(!extent_multiply(n,l,&nl) || !extent_multiply(nl,m,&nlm) || !extent_multiply(nlm,p,&nlmp) ||
+	   !extent_multiply(n,sizeof(T ***),&table) || !extent_multiply(nl,sizeof(T **),&table) || !extent_multiply(nlm,sizeof(T *),&table))
+		return (T ****) alloc_failed(false,ENOMEM,NULL);
+
+	x      = new(std::nothrow) T ***[n];
+	planes = new(std::nothrow) T  **[nl];
+	rows   = new(std::nothrow) T   *[nlm];
+	if(!x || !planes || !rows)
+	{
+		delete[] rows;
+		delete[] planes;
+		delete[] x;
+		return (T ****) alloc_failed(false,ENOMEM,NULL);
+	}
+	if(!(data = array_slab(nlmp,init,value,false)))
+	{
+		delete[] rows;
+		delete[] planes;
+		delete[] x;
+		return NULL;
+	}
+
+	for(size_t k=0;k<nlm;k++)
+		rows[k] = data + k*p;
+	for(size_t j=0;j<nl;j++)
+		planes[j] = rows + j*m;
+	for(size_t i=0;i<n;i++)
+		x[i] = planes + i*l;
+
+	if(nlm==0)
+		free_aligned(data);
+	if(nl==0)
+		delete[] rows;
+	if(n==0)
+		delete[] planes;
+
+	alloc_record(x,n*sizeof(T ***) + nl*sizeof(T **) + nlm*sizeof(T *));
+	return x;
+}
+
+/*! \fn double **two_dimensional_contiguous_array(size_t n, size_t l, array_init init, double value)
+ *  \brief Allocate a two dimensional (n x l) array backed by a single
+ *         contiguous slab of n*l doubles.
  */
-int compare_doubles(const void *a, const void *b)
+double **two_dimensional_contiguous_array(size_t n, size_t l, array_init init, double value)
 {
-	//compare doubles, from GNU C Library Ref. Manual
-	const double *da = (const double *) a;
-	const double *db = (const double *) b;
-	return (*da > *db) - (*da < *db);
+	double **x;
+
+	if(!(x = contiguous_array_2d(n,l,init,value)))
+	{
+		printf("Error allocating two dimensional contiguous array (%zu x %zu).\n",n,l);
+		fflush(stdout);
+		exit(-1);
+	}
+	return x;
+}
+/*! \fn void deallocate_two_dimensional_contiguous_array(double **x, size_t n, size_t l)
+ *  \brief De-allocate an array from two_dimensional_contiguous_array
+ */
+void deallocate_two_dimensional_contiguous_array(double **x, size_t n, size_t l)
+{
+	alloc_release(x);
+	if(n>0)
+		free_aligned(x[0]);
+	delete[] x;
+}
+/*! \fn double **try_two_dimensional_contiguous_array(size_t n, size_t l, array_init init, double value)
+ *  \brief As two_dimensional_contiguous_array, returning NULL with errno set on failure.
+ */
+double **try_two_dimensional_contiguous_array(size_t n, size_t l, array_init init, double value)
+{
+	return contiguous_array_2d(n,l,init,value);
+}
+/*! \fn double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init, double value)
+ *  \brief Allocate a three dimensional (n x l x m) array backed by a single
+ *         contiguous slab.
+ */
+double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init, double value)
+{
+	double ***x;
+
+	if(!(x = contiguous_array_3d(n,l,m,init,value)))
+	{
+		printf("Error allocating three dimensional contiguous array (%zu x %zu x %zu).\n",n,l,m);
+		fflush(stdout);
+		exit(-1);
+	}
+	return x;
+}
+/*! \fn void deallocate_three_dimensional_contiguous_array(double ***x, size_t n, size_t l, size_t m)
+ *  \brief De-allocate an array from three_dimensional_contiguous_array
+ */
+void deallocate_three_dimensional_contiguous_array(double ***x, size_t n, size_t l, size_t m)
+{
+	alloc_release(x);
+	if(n>0)
+	{
+		if(l>0)
+			free_aligned(x[0][0]);
+		delete[] x[0];
+	}
+	delete[] x;
+}
+/*! \fn double ***try_three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init, double value)
+ *  \brief As three_dimensional_contiguous_array, returning NULL with errno set on failure.
+ */
+double ***try_three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init, double value)
+{
+	return contiguous_array_3d(n,l,m,init,value);
+}
+/*! \fn double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+ *  \brief Allocate a four dimensional (n x l x m x p) array backed by a single
+ *         contiguous slab.
+ */
+double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+{
+	double ****x;
+
+	if(!(x = contiguous_array_4d(n,l,m,p,init,value)))
+	{
+		printf("Error allocating four dimensional contiguous array (%zu x %zu x %zu x %zu).\n",n,l,m,p);
+		fflush(stdout);
+		exit(-1);
+	}
+	return x;
+}
+/*! \fn void deallocate_four_dimensional_contiguous_array(double ****x, size_t n, size_t l, size_t m, size_t p)
+ *  \brief De-allocate an array from four_dimensional_contiguous_array
+ */
+void deallocate_four_dimensional_contiguous_array(double ****x, size_t n, size_t l, size_t m, size_t p)
+{
+	alloc_release(x);
+	if(n>0)
+	{
+		if(l>0)
+		{
+			if(m>0)
+				free_aligned(x[0][0][0]);
+			delete[] x[0][0];
+		}
+		delete[] x[0];
+	}
+	delete[] x;
+}
+/*! \fn double ****try_four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+ *  \brief As four_dimensional_contiguous_array, returning NULL with errno set on failure.
+ */
+double ****try_four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+{
+	return contiguous_array_4d(n,l,m,p,init,value);
+}
+/*! \fn int ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, array_init init, int value)
+ *  \brief Allocate a three dimensional (n x l x m) int array backed by a single
+ *         contiguous slab.
+ */
+int ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, array_init init, int value)
+{
+	int ***x;
+
+	if(!(x = contiguous_array_3d(n,l,m,init,value)))
+	{
+		printf("Error allocating three dimensional contiguous int array (%zu x %zu x %zu).\n",n,l,m);
+		fflush(stdout);
+		exit(-1);
+	}
+	return x;
+}
+/*! \fn void deallocate_three_dimensional_contiguous_int_array(int ***x, size_t n, size_t l, size_t m)
+ *  \brief De-allocate an array from three_dimensional_contiguous_int_array
+ */
+void deallocate_three_dimensional_contiguous_int_array(int ***x, size_t n, size_t l, size_t m)
+{
+	alloc_release(x);
+	if(n>0)
+	{
+		if(l>0)
+			free_aligned(x[0][0]);
+		delete[] x[0];
+	}
+	delete[] x;
+}
+/*! \fn float **two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init, float value)
+ *  \brief Allocate a two dimensional (n x l) float array backed by a single
+ *         contiguous slab.
+ */
+float **two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init, float value)
+{
+	float **x;
+
+	if(!(x = contiguous_array_2d(n,l,init,value)))
+	{
+		printf("Error allocating two dimensional contiguous float array (%zu x %zu).\n",n,l);
+		fflush(stdout);
+		exit(-1);
+	}
+	return x;
+}
+/*! \fn void deallocate_two_dimensional_contiguous_float_array(float **x, size_t n, size_t l)
+ *  \brief De-allocate an array from two_dimensional_contiguous_float_array
+ */
+void deallocate_two_dimensional_contiguous_float_array(float **x, size_t n, size_t l)
+{
+	alloc_release(x);
+	if(n>0)
+		free_aligned(x[0]);
+	delete[] x;
+}
+/*! \fn float **try_two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init, float value)
+ *  \brief As two_dimensional_contiguous_float_array, returning NULL with errno set on failure.
+ */
+float **try_two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init, float value)
+{
+	return contiguous_array_2d(n,l,init,value);
+}
+/*! \fn float ***three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init, float value)
+ *  \brief Allocate a three dimensional (n x l x m) float array backed by a single
+ *         contiguous slab.
+ */
+float ***three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init, float value)
+{
+	float ***x;
+
+	if(!(x = contiguous_array_3d(n,l,m,init,value)))
+	{
+		printf("Error allocating three dimensional contiguous float array (%zu x %zu x %zu).\n",n,l,m);
+		fflush(stdout);
+		exit(-1);
+	}
+	return x;
+}
+/*! \fn void deallocate_three_dimensional_contiguous_float_array(float ***x, size_t n, size_t l, size_t m)
+ *  \brief De-allocate an array from three_dimensional_contiguous_float_array
+ */
+void deallocate_three_dimensional_contiguous_float_array(float ***x, size_t n, size_t l, size_t m)
+{
+	alloc_release(x);
+	if(n>0)
+	{
+		if(l>0)
+			free_aligned(x[0][0]);
+		delete[] x[0];
+	}
+	delete[] x;
+}
+/*! \fn float ***try_three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init, float value)
+ *  \brief As three_dimensional_contiguous_float_array, returning NULL with errno set on failure.
+ */
+float ***try_three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init, float value)
+{
+	return contiguous_array_3d(n,l,m,init,value);
+}
+
+
+/*! \fn double **two_dimensional_contiguous_array(size_t n, size_t l, numa_placement placement, int node)
+ *  \brief Allocate a contiguous two dimensional (n x l) array whose pages
+ *         are placed as placement asks.
+ */
+double **two_dimensional_contiguous_array(size_t n, size_t l, numa_placement placement, int node)
+{
+	double **x;
+	double  *data;
+	size_t   row = extent_product(l,sizeof(double));
+
+	//check the slab and row table before new[] can throw on them
+	extent_product(n,row);
+	extent_product(n,sizeof(double *));
+	x    = new double *[n];
+	data = (double *) numa_slab(n,row,placement,node);
+	for(size_t i=0;i<n;i++)
+		x[i] = data + i*l;
+
+	if(n==0)
+		free_aligned(data);
+
+	alloc_record(x,n*sizeof(double *));
+	return x;
+}
+/*! \fn double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, numa_placement placement, int node)
+ *  \brief Allocate a contiguous three dimensional (n x l x m) array whose
+ *         pages are placed as placement asks.
+ */
+double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, numa_placement placement, int node)
+{
+	double ***x;
+	double  **rows;
+	double   *data;
+	size_t    nl  = extent_product(n,l);
+	size_t    row = extent_product(extent_product(l,m),sizeof(double));
+
+	//check the slab and row table before new[] can throw on them
+	extent_product(n,row);
+	extent_product(nl,sizeof(double *));
+	x    = new double **[n];
+	rows = new double  *[nl];
+	data = (double *) numa_slab(n,row,placement,node);
+
+	for(size_t j=0;j<nl;j++)
+		rows[j] = data + j*m;
+	for(size_t i=0;i<n;i++)
+		x[i] = rows + i*l;
+
+	if(nl==0)
+		free_aligned(data);
+	if(n==0)
+		delete[] rows;
+
+	alloc_record(x,n*sizeof(double **) + nl*sizeof(double *));
+	return x;
+}
+
+/*! \struct arena_block
+ *  \brief One block of memory in an arena's chain. */
+struct arena_block
+{
+	char        *base;
+	size_t       size;
+	size_t       used;
+	arena_block *prev;
+};
+
+/*! \struct arena
+ *  \brief Bump-pointer allocator, current block at the head of the chain. */
+struct arena
+{
+	arena_block *block;
+	size_t       block_size;
+	size_t       used;
+};
+
+/*! \fn static arena_block *arena_block_create(size_t nbytes, size_t alignment, arena_block *prev)
+ *  \brief Allocate a new arena block of nbytes, chained to prev. */
+static arena_block *arena_block_create(size_t nbytes, size_t alignment, arena_block *prev)
+{
+	arena_block *b;
+
+	if(!(b = (arena_block *) malloc(sizeof(arena_block))))
+	{
+		printf("Error allocating arena block.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	if(alignment<ROUTINES_ALIGNMENT)
+		alignment = ROUTINES_ALIGNMENT;
+	b->base = (char *) calloc_aligned(nbytes,1,alignment);
+	b->size = nbytes;
+	b->used = 0;
+	b->prev = prev;
+	return b;
+}
+
+/*! \fn arena *arena_create(size_t nbytes)
+ *  \brief Create an arena with an initial block of nbytes
+ */
+arena *arena_create(size_t nbytes)
+{
+	arena *a;
+
+	if(!(a = (arena *) malloc(sizeof(arena))))
+	{
+		printf("Error allocating arena.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	if(nbytes==0)
+		nbytes = 4096;
+	a->block      = arena_block_create(nbytes,ROUTINES_ALIGNMENT,NULL);
+	a->block_size = nbytes;
+	a->used       = 0;
+	return a;
+}
+
+/*! \fn static void arena_free_blocks(arena_block *b)
+ *  \brief Free a chain of arena blocks. */
+static void arena_free_blocks(arena_block *b)
+{
+	arena_block *prev;
+
+	while(b)
+	{
+		prev = b->prev;
+		free_aligned(b->base);
+		free(b);
+		b = prev;
+	}
+}
+
+/*! \fn void arena_destroy(arena *a)
+ *  \brief Release an arena and all memory allocated from it
+ */
+void arena_destroy(arena *a)
+{
+	if(!a)
+		return;
+	arena_free_blocks(a->block);
+	free(a);
+}
+
+/*! \fn void arena_reset(arena *a)
+ *  \brief Invalidate all allocations from an arena so its memory can be reused
+ */
+void arena_reset(arena *a)
+{
+	size_t total = 0;
+
+	//if the arena overflowed, replace the chain with one
+	//block large enough for everything used this time
+	if(a->block->prev)
+	{
+		for(arena_block *b=a->block;b;b=b->prev)
+			total += b->size;
+		arena_free_blocks(a->block);
+		a->block      = arena_block_create(total,ROUTINES_ALIGNMENT,NULL);
+		a->block_size = total;
+	}
+	a->block->used = 0;
+	a->used        = 0;
+}
+
+/*! \fn void *arena_alloc(arena *a, size_t n, size_t size, size_t alignment)
+ *  \brief Allocate uninitialized space for n elements of size bytes from an arena
+ */
+void *arena_alloc(arena *a, size_t n, size_t size, size_t alignment)
+{
+	arena_block *b = a->block;
+	size_t       nbytes;
+	size_t       offset;
+
+	if(alignment==0 || (alignment & (alignment-1)) || alignment>ROUTINES_MAX_ALIGNMENT)
+	{
+		printf("Error: arena alignment %zu must be a power of two no larger than %d.\n",alignment,ROUTINES_MAX_ALIGNMENT);
+		fflush(stdout);
+		exit(-1);
+	}
+	if(size && n>((size_t) -1)/size)
+	{
+		printf("Error allocating arena array of %zu elements of size %zu (overflow).\n",n,size);
+		fflush(stdout);
+		exit(-1);
+	}
+	nbytes = n*size;
+
+	//bump the pointer, chaining a new block if this one is full;
+	//the block itself may be less aligned than this request
+	offset = ((((uintptr_t) b->base) + b->used + alignment-1) & ~((uintptr_t) alignment-1)) - (uintptr_t) b->base;
+	if(offset>b->size || nbytes>b->size-offset)
+	{
+		b      = arena_block_create(GSL_MAX(a->block_size,nbytes),alignment,b);
+		offset = 0;
+		a->block = b;
+	}
+	b->used  = offset + nbytes;
+	a->used += nbytes;
+
+	return b->base + offset;
+}
+
+/*! \fn size_t arena_bytes_used(const arena *a)
+ *  \brief Number of bytes allocated from an arena since the last reset
+ */
+size_t arena_bytes_used(const arena *a)
+{
+	return a->used;
+}
+
+/*! \fn double **two_dimensional_contiguous_array(size_t n, size_t l, arena *a, array_init init, double value)
+ *  \brief Allocate a contiguous two dimensional (n x l) array from an arena.
+ */
+double **two_dimensional_contiguous_array(size_t n, size_t l, arena *a, array_init init, double value)
+{
+	double **x;
+	double  *data;
+	size_t   nl = extent_product(n,l);
+
+	x    = (double **) arena_alloc(a,n,sizeof(double *));
+	data = (double *)  arena_alloc(a,nl,sizeof(double));
+	array_fill(data,nl,init,value);
+	for(size_t i=0;i<n;i++)
+		x[i] = data + i*l;
+
+	return x;
+}
+
+/*! \fn double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, arena *a, array_init init, double value)
+ *  \brief Allocate a contiguous three dimensional (n x l x m) array from an arena.
+ */
+double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, arena *a, array_init init, double value)
+{
+	double ***x;
+	double  **rows;
+	double   *data;
+	size_t    nl  = extent_product(n,l);
+	size_t    nlm = extent_product(nl,m);
+
+	x    = (double ***) arena_alloc(a,n,sizeof(double **));
+	rows = (double **)  arena_alloc(a,nl,sizeof(double *));
+	data = (double *)   arena_alloc(a,nlm,sizeof(double));
+	array_fill(data,nlm,init,value);
+
+	for(size_t j=0;j<nl;j++)
+		rows[j] = data + j*m;
+	for(size_t i=0;i<n;i++)
+		x[i] = rows + i*l;
+
+	return x;
+}
+
+/*! \fn double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, arena *a, array_init init, double value)
+ *  \brief Allocate a contiguous four dimensional (n x l x m x p) array from an arena.
+ */
+double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, arena *a, array_init init, double value)
+{
+	double ****x;
+	double  ***planes;
+	double   **rows;
+	double    *data;
+	size_t     nl   = extent_product(n,l);
+	size_t     nlm  = extent_product(nl,m);
+	size_t     nlmp = extent_product(nlm,p);
+
+	x      = (double ****) arena_alloc(a,n,sizeof(double ***));
+	planes = (double ***)  arena_alloc(a,nl,sizeof(double **));
+	rows   = (double **)   arena_alloc(a,nlm,sizeof(double *));
+	data   = (double *)    arena_alloc(a,nlmp,sizeof(double));
+	array_fill(data,nlmp,init,value);
+
+	for(size_t k=0;k<nlm;k++)
+		rows[k] = data + k*p;
+	for(size_t j=0;j<nl;j++)
+		planes[j] = rows + j*m;
+	for(size_t i=0;i<n;i++)
+		x[i] = planes + i*l;
+
+	return x;
+}
+
+/*! \fn int ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, arena *a, array_init init, int value)
+ *  \brief Allocate a contiguous three dimensional (n x l x m) int array from an arena.
+ */
+int ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, arena *a, array_init init, int value)
+{
+	int    ***x;
+	int     **rows;
+	int      *data;
+	size_t    nl  = extent_product(n,l);
+	size_t    nlm = extent_product(nl,m);
+
+	x    = (int ***) arena_alloc(a,n,sizeof(int **));
+	rows = (int **)  arena_alloc(a,nl,sizeof(int *));
+	data = (int *)   arena_alloc(a,nlm,sizeof(int));
+	array_fill(data,nlm,init,value);
+
+	for(size_t j=0;j<nl;j++)
+		rows[j] = data + j*m;
+	for(size_t i=0;i<n;i++)
+		x[i] = rows + i*l;
+
+	return x;
+}
+
+
+/* Binary array files.
+
+   An array file is an array_file_header followed by the elements in
+   row-major order, native byte order.  The header records the element
+   type and the extent of every dimension, so readers need not know
+   the shape in advance.  Data are moved in large blocks: single slabs,
+   such as the data of the contiguous allocators, go to fread/fwrite in
+   one call, which glibc's stdio passes to read/write without copying
+   once a request is longer than its buffer, and rows from the other
+   allocators are gathered into a buffer of array_io_block_set bytes
+   first, so the number of system calls does not depend on the length
+   of a row. */
+
+#define ROUTINES_ARRAY_MAGIC   "BRARRAY"
+#define ROUTINES_ARRAY_VERSION 1
+#define ROUTINES_BYTE_ORDER    0x01020304
+
+/*! \struct array_file_header
+ *  \brief Leading record of a binary array file, 64 bytes. */
+struct array_file_header
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t dtype;
+	uint32_t rank;
+	uint64_t shape[ROUTINES_ARRAY_MAX_RANK];
+	uint64_t reserved;
+};
+
+/*! \fn static size_t array_dtype_size(array_dtype dtype)
+ *  \brief Size in bytes of one element of type dtype. */
+static size_t array_dtype_size(array_dtype dtype)
+{
+	switch(dtype)
+	{
+		case DTYPE_DOUBLE: return sizeof(double);
+		case DTYPE_FLOAT:  return sizeof(float);
+		case DTYPE_INT:    return sizeof(int);
+	}
+	return 0;
+}
+
+/*! \fn void fwrite_brant(const void *x, size_t size, size_t n, FILE *fp)
+ *  \brief Safe method for writing n elements of size bytes. */
+void fwrite_brant(const void *x, size_t size, size_t n, FILE *fp)
+{
+	if(fwrite(x,size,n,fp)!=n)
+	{
+		printf("Error writing %zu elements of %zu bytes.\n",n,size);
+		fflush(stdout);
+		exit(-1);
+	}
+}
+
+/*! \fn void fread_brant(void *x, size_t size, size_t n, FILE *fp)
+ *  \brief Safe method for reading n elements of size bytes. */
+void fread_brant(void *x, size_t size, size_t n, FILE *fp)
+{
+	if(fread(x,size,n,fp)!=n)
+	{
+		printf("Error reading %zu elements of %zu bytes.\n",n,size);
+		fflush(stdout);
+		exit(-1);
+	}
+}
+
+/*! \fn void write_array_header(FILE *fp, array_dtype dtype, int rank, const size_t *shape)
+ *  \brief Write the header of a binary array file. */
+void write_array_header(FILE *fp, array_dtype dtype, int rank, const size_t *shape)
+{
+	array_file_header h;
+
+	if(rank<1 || rank>ROUTINES_ARRAY_MAX_RANK || !array_dtype_size(dtype))
+	{
+		printf("Error: write_array_header rank = %d, dtype = %d.\n",rank,(int) dtype);
+		fflush(stdout);
+		exit(-1);
+	}
+
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,ROUTINES_ARRAY_MAGIC,sizeof(ROUTINES_ARRAY_MAGIC));
+	h.version    = ROUTINES_ARRAY_VERSION;
+	h.byte_order = ROUTINES_BYTE_ORDER;
+	h.dtype      = dtype;
+	h.rank       = rank;
+	for(int d=0;d<rank;d++)
+		h.shape[d] = shape[d];
+	fwrite_brant(&h,sizeof(h),1,fp);
+}
+
+/*! \fn static void array_header_check(const array_file_header *h, array_dtype dtype, int rank, size_t *shape)
+ *  \brief Check that h describes a rank dimensional array of dtype in this
+ *         machine's byte order, and store its extents in shape. */
+static void array_header_check(const array_file_header *h, array_dtype dtype, int rank, size_t *shape)
+{
+	if(memcmp(h->magic,ROUTINES_ARRAY_MAGIC,sizeof(ROUTINES_ARRAY_MAGIC))!=0 || h->version!=ROUTINES_ARRAY_VERSION)
+	{
+		printf("Error: not a binary array file.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	if(h->byte_order!=ROUTINES_BYTE_ORDER)
+	{
+		printf("Error: binary array file has the wrong byte order.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	if(h->dtype!=(uint32_t) dtype || h->rank!=(uint32_t) rank)
+	{
+		printf("Error: binary array file holds dtype %u rank %u, expected dtype %d rank %d.\n",h->dtype,h->rank,(int) dtype,rank);
+		fflush(stdout);
+		exit(-1);
+	}
+	for(int d=0;d<rank;d++)
+		shape[d] = h->shape[d];
+}
+
+/*! \fn void read_array_header(FILE *fp, array_dtype dtype, int rank, size_t *shape)
+ *  \brief Read the header of a binary array file, which must hold a
+ *         rank dimensional array of dtype, and return its shape. */
+void read_array_header(FILE *fp, array_dtype dtype, int rank, size_t *shape)
+{
+	array_file_header h;
+
+	fread_brant(&h,sizeof(h),1,fp);
+	array_header_check(&h,dtype,rank,shape);
+}
+
+static std::atomic<size_t> io_block_bytes(ROUTINES_IO_BLOCK);
+
+/*! \fn void array_io_block_set(size_t nbytes)
+ *  \brief Set the size of the buffer the array writers gather rows into */
+void array_io_block_set(size_t nbytes)
+{
+	if(nbytes==0)
+	{
+		printf("Error: array_io_block_set nbytes = 0.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	io_block_bytes.store(nbytes);
+}
+
+/*! \struct io_block
+ *  \brief Buffer gathering small writes into block sized ones. */
+struct io_block
+{
+	FILE   *fp;
+	char   *buf;
+	size_t  size;
+	size_t  used;
+};
+
+/*! \fn static void io_block_flush(io_block *b)
+ *  \brief Write out whatever is buffered. */
+static void io_block_flush(io_block *b)
+{
+	if(b->used)
+		fwrite_brant(b->buf,1,b->used,b->fp);
+	b->used = 0;
+}
+
+/*! \fn static void io_block_put(io_block *b, const void *p, size_t nbytes)
+ *  \brief Append nbytes at p, writing pieces at least a block long directly. */
+static void io_block_put(io_block *b, const void *p, size_t nbytes)
+{
+	if(nbytes>=b->size)
+	{
+		io_block_flush(b);
+		fwrite_brant(p,1,nbytes,b->fp);
+		return;
+	}
+	if(b->used+nbytes>b->size)
+		io_block_flush(b);
+	memcpy(b->buf+b->used,p,nbytes);
+	b->used += nbytes;
+}
+
+/*! \fn static void write_rows(FILE *fp, T **rows, size_t nrows, size_t len)
+ *  \brief Write nrows rows of len elements, in one call if they are adjacent. */
+template<typename T>
+static void write_rows(FILE *fp, T **rows, size_t nrows, size_t len)
+{
+	io_block b;
+	size_t   i = 1;
+
+	if(nrows==0 || len==0)
+		return;
+
+	for(;i<nrows;i++)
+		if(rows[i]!=rows[0]+i*len)
+			break;
+	if(i==nrows)
+	{
+		fwrite_brant(rows[0],sizeof(T),nrows*len,fp);
+		return;
+	}
+
+	b.fp   = fp;
+	b.size = io_block_bytes.load(std::memory_order_relaxed);
+	b.buf  = (char *) calloc_aligned(b.size,1,ROUTINES_ALIGNMENT);
+	b.used = 0;
+	for(i=0;i<nrows;i++)
+		io_block_put(&b,rows[i],len*sizeof(T));
+	io_block_flush(&b);
+	free_aligned(b.buf);
+}
+
+/*! \fn static int array_extent(size_t e)
+ *  \brief Check that an extent read from a file fits the int interface. */
+static int array_extent(size_t e)
+{
+	if(e>(size_t) INT_MAX)
+	{
+		printf("Error: array extent %zu too large for an int (use the size_t form).\n",e);
+		fflush(stdout);
+		exit(-1);
+	}
+	return (int) e;
+}
+
+/*! \fn void write_double_array(FILE *fp, double *x, size_t n)
+ *  \brief Write a double array with its header. */
+void write_double_array(FILE *fp, double *x, size_t n)
+{
+	size_t shape[1] = {n};
+
+	write_array_header(fp,DTYPE_DOUBLE,1,shape);
+	fwrite_brant(x,sizeof(double),n,fp);
+}
+
+/*! \fn double *read_double_array(FILE *fp, size_t *n)
+ *  \brief Read a double array written by write_double_array. */
+double *read_double_array(FILE *fp, size_t *n)
+{
+	size_t  shape[1];
+	double *x;
+
+	read_array_header(fp,DTYPE_DOUBLE,1,shape);
+	*n = shape[0];
+	x  = calloc_double_array(*n);
+	fread_brant(x,sizeof(double),*n,fp);
+	return x;
+}
+/*! \fn double *read_double_array(FILE *fp, int *n)
+ *  \brief Read a double array written by write_double_array. */
+double *read_double_array(FILE *fp, int *n)
+{
+	size_t  ns;
+	double *x = read_double_array(fp,&ns);
+
+	*n = array_extent(ns);
+	return x;
+}
+
+/*! \fn void write_two_dimensional_array(FILE *fp, double **x, size_t n, size_t l)
+ *  \brief Write a two dimensional array with its header. */
+void write_two_dimensional_array(FILE *fp, double **x, size_t n, size_t l)
+{
+	size_t shape[2] = {n, l};
+
+	write_array_header(fp,DTYPE_DOUBLE,2,shape);
+	write_rows(fp,x,n,l);
+}
+
+/*! \fn double **read_two_dimensional_array(FILE *fp, size_t *n, size_t *l)
+ *  \brief Read a two dimensional array written by write_two_dimensional_array. */
+double **read_two_dimensional_array(FILE *fp, size_t *n, size_t *l)
+{
+	size_t   shape[2];
+	double **x;
+
+	read_array_header(fp,DTYPE_DOUBLE,2,shape);
+	*n = shape[0];
+	*l = shape[1];
+	x  = two_dimensional_contiguous_array(*n,*l,ARRAY_UNINITIALIZED);
+	if(*n>0)
+		fread_brant(x[0],sizeof(double),shape[0]*shape[1],fp);
+	return x;
+}
+/*! \fn double **read_two_dimensional_array(FILE *fp, int *n, int *l)
+ *  \brief Read a two dimensional array written by write_two_dimensional_array. */
+double **read_two_dimensional_array(FILE *fp, int *n, int *l)
+{
+	size_t   ns, ls;
+	double **x = read_two_dimensional_array(fp,&ns,&ls);
+
+	*n = array_extent(ns);
+	*l = array_extent(ls);
+	return x;
+}
+
+/*! \fn static void write_array_3d(FILE *fp, array_dtype dtype, T ***x, size_t n, size_t l, size_t m)
+ *  \brief Write a three dimensional array of dtype with its header. */
+template<typename T>
+static void write_array_3d(FILE *fp, array_dtype dtype, T ***x, size_t n, size_t l, size_t m)
+{
+	size_t shape[3] = {n, l, m};
+	size_t i = 1;
+
+	write_array_header(fp,dtype,3,shape);
+
+	//contiguous arrays share one table of rows
+	for(;i<n;i++)
+		if(x[i]!=x[0]+i*l)
+			break;
+	if(i>=n)
+	{
+		if(n>0)
+			write_rows(fp,x[0],n*l,m);
+		return;
+	}
+	for(i=0;i<n;i++)
+		write_rows(fp,x[i],l,m);
+}
+
+/*! \fn void write_three_dimensional_array(FILE *fp, double ***x, size_t n, size_t l, size_t m)
+ *  \brief Write a three dimensional array with its header. */
+void write_three_dimensional_array(FILE *fp, double ***x, size_t n, size_t l, size_t m)
+{
+	write_array_3d(fp,DTYPE_DOUBLE,x,n,l,m);
+}
+
+/*! \fn double ***read_three_dimensional_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+ *  \brief Read a three dimensional array written by write_three_dimensional_array. */
+double ***read_three_dimensional_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+{
+	size_t    shape[3];
+	double ***x;
+
+	read_array_header(fp,DTYPE_DOUBLE,3,shape);
+	*n = shape[0];
+	*l = shape[1];
+	*m = shape[2];
+	x  = three_dimensional_contiguous_array(*n,*l,*m,ARRAY_UNINITIALIZED);
+	if(*n>0 && *l>0)
+		fread_brant(x[0][0],sizeof(double),shape[0]*shape[1]*shape[2],fp);
+	return x;
+}
+/*! \fn double ***read_three_dimensional_array(FILE *fp, int *n, int *l, int *m)
+ *  \brief Read a three dimensional array written by write_three_dimensional_array. */
+double ***read_three_dimensional_array(FILE *fp, int *n, int *l, int *m)
+{
+	size_t    ns, ls, ms;
+	double ***x = read_three_dimensional_array(fp,&ns,&ls,&ms);
+
+	*n = array_extent(ns);
+	*l = array_extent(ls);
+	*m = array_extent(ms);
+	return x;
+}
+
+/*! \fn void write_float_array(FILE *fp, float *x, size_t n)
+ *  \brief Write a float array with its header. */
+void write_float_array(FILE *fp, float *x, size_t n)
+{
+	size_t shape[1] = {n};
+
+	write_array_header(fp,DTYPE_FLOAT,1,shape);
+	fwrite_brant(x,sizeof(float),n,fp);
+}
+
+/*! \fn float *read_float_array(FILE *fp, size_t *n)
+ *  \brief Read a float array written by write_float_array. */
+float *read_float_array(FILE *fp, size_t *n)
+{
+	size_t  shape[1];
+	float  *x;
+
+	read_array_header(fp,DTYPE_FLOAT,1,shape);
+	*n = shape[0];
+	x  = calloc_float_array(*n);
+	fread_brant(x,sizeof(float),*n,fp);
+	return x;
+}
+
+/*! \fn void write_two_dimensional_float_array(FILE *fp, float **x, size_t n, size_t l)
+ *  \brief Write a two dimensional float array with its header. */
+void write_two_dimensional_float_array(FILE *fp, float **x, size_t n, size_t l)
+{
+	size_t shape[2] = {n, l};
+
+	write_array_header(fp,DTYPE_FLOAT,2,shape);
+	write_rows(fp,x,n,l);
+}
+
+/*! \fn float **read_two_dimensional_float_array(FILE *fp, size_t *n, size_t *l)
+ *  \brief Read a two dimensional array written by write_two_dimensional_float_array. */
+float **read_two_dimensional_float_array(FILE *fp, size_t *n, size_t *l)
+{
+	size_t  shape[2];
+	float **x;
+
+	read_array_header(fp,DTYPE_FLOAT,2,shape);
+	*n = shape[0];
+	*l = shape[1];
+	x  = two_dimensional_contiguous_float_array(*n,*l,ARRAY_UNINITIALIZED);
+	if(*n>0)
+		fread_brant(x[0],sizeof(float),shape[0]*shape[1],fp);
+	return x;
+}
+
+/*! \fn void write_three_dimensional_float_array(FILE *fp, float ***x, size_t n, size_t l, size_t m)
+ *  \brief Write a three dimensional float array with its header. */
+void write_three_dimensional_float_array(FILE *fp, float ***x, size_t n, size_t l, size_t m)
+{
+	write_array_3d(fp,DTYPE_FLOAT,x,n,l,m);
+}
+
+/*! \fn float ***read_three_dimensional_float_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+ *  \brief Read a three dimensional array written by write_three_dimensional_float_array. */
+float ***read_three_dimensional_float_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+{
+	size_t   shape[3];
+	float ***x;
+
+	read_array_header(fp,DTYPE_FLOAT,3,shape);
+	*n = shape[0];
+	*l = shape[1];
+	*m = shape[2];
+	x  = three_dimensional_contiguous_float_array(*n,*l,*m,ARRAY_UNINITIALIZED);
+	if(*n>0 && *l>0)
+		fread_brant(x[0][0],sizeof(float),shape[0]*shape[1]*shape[2],fp);
+	return x;
+}
+
+/*! \fn void write_int_array(FILE *fp, int *x, size_t n)
+ *  \brief Write an int array with its header. */
+void write_int_array(FILE *fp, int *x, size_t n)
+{
+	size_t shape[1] = {n};
+
+	write_array_header(fp,DTYPE_INT,1,shape);
+	fwrite_brant(x,sizeof(int),n,fp);
+}
+
+/*! \fn int *read_int_array(FILE *fp, size_t *n)
+ *  \brief Read an int array written by write_int_array. */
+int *read_int_array(FILE *fp, size_t *n)
+{
+	size_t  shape[1];
+	int    *x;
+
+	read_array_header(fp,DTYPE_INT,1,shape);
+	*n = shape[0];
+	x  = calloc_int_array(*n);
+	fread_brant(x,sizeof(int),*n,fp);
+	return x;
+}
+
+/*! \fn void write_three_dimensional_int_array(FILE *fp, int ***x, size_t n, size_t l, size_t m)
+ *  \brief Write a three dimensional int array with its header. */
+void write_three_dimensional_int_array(FILE *fp, int ***x, size_t n, size_t l, size_t m)
+{
+	write_array_3d(fp,DTYPE_INT,x,n,l,m);
+}
+
+/*! \fn int ***read_three_dimensional_int_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+ *  \brief Read a three dimensional array written by write_three_dimensional_int_array. */
+int ***read_three_dimensional_int_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+{
+	size_t  shape[3];
+	int  ***x;
+
+	read_array_header(fp,DTYPE_INT,3,shape);
+	*n = shape[0];
+	*l = shape[1];
+	*m = shape[2];
+	x  = three_dimensional_contiguous_int_array(*n,*l,*m,ARRAY_UNINITIALIZED);
+	if(*n>0 && *l>0)
+		fread_brant(x[0][0],sizeof(int),shape[0]*shape[1]*shape[2],fp);
+	return x;
+}
+
+
+/* Mapped array files.
+
+   The map_* routines map a whole binary array file and return pointers
+   into the mapping, after the header, with row tables from new[] built
+   exactly as the contiguous allocators build theirs.  The header is 64
+   bytes, so the data stay 64 byte aligned in the page-aligned mapping.
+   The unmap_* routines recover the mapping from the data pointer. */
+
+/*! \fn static double *map_array_file(char fname[], int rank, size_t *shape, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a double array file of the given rank; returns its data. */
+static double *map_array_file(char fname[], int rank, size_t *shape, array_map_mode mode, array_map_advice advice)
+{
+	array_file_header h;
+	struct stat st;
+	size_t  count = 1;
+	size_t  bytes;
+	bool    ok = true;
+	void   *map;
+	int     fd;
+
+	if((fd = open(fname,O_RDONLY))<0)
+	{
+		printf("Error opening %s.\n",fname);
+		fflush(stdout);
+		exit(-1);
+	}
+	if(fstat(fd,&st)!=0 || (size_t) st.st_size<sizeof(h))
+	{
+		printf("Error: %s is not a binary array file.\n",fname);
+		fflush(stdout);
+		exit(-1);
+	}
+
+	//copy-on-write pages are private to this process;
+	//read-only pages are shared through the page cache
+	if(mode==ARRAY_MAP_COPY_ON_WRITE)
+		map = mmap(NULL,st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+	else
+		map = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(map==MAP_FAILED)
+	{
+		printf("Error mapping %s.\n",fname);
+		fflush(stdout);
+		exit(-1);
+	}
+
+	memcpy(&h,map,sizeof(h));
+	array_header_check(&h,DTYPE_DOUBLE,rank,shape);
+	for(int d=0;d<rank;d++)
+		ok = ok && extent_multiply(count,shape[d],&count);
+	if(!ok || !extent_multiply(count,sizeof(double),&bytes))
+	{
+		printf("Error: %s has a header shape too large for any file (overflow).\n",fname);
+		fflush(stdout);
+		exit(-1);
+	}
+	if((size_t) st.st_size!=sizeof(h)+bytes)
+	{
+		printf("Error: %s is %zu bytes, expected %zu.\n",fname,(size_t) st.st_size,sizeof(h)+bytes);
+		fflush(stdout);
+		exit(-1);
+	}
+
+	switch(advice)
+	{
+		case ARRAY_ADVICE_NORMAL:     break;
+		case ARRAY_ADVICE_SEQUENTIAL: madvise(map,st.st_size,MADV_SEQUENTIAL); break;
+		case ARRAY_ADVICE_RANDOM:     madvise(map,st.st_size,MADV_RANDOM);     break;
+		case ARRAY_ADVICE_WILLNEED:   madvise(map,st.st_size,MADV_WILLNEED);   break;
+	}
+
+	return (double *) ((char *) map + sizeof(h));
+}
+
+/*! \fn static void unmap_array_file(double *data, size_t count)
+ *  \brief Release a mapping from map_array_file holding count doubles. */
+static void unmap_array_file(double *data, size_t count)
+{
+	munmap((char *) data - sizeof(array_file_header),sizeof(array_file_header)+count*sizeof(double));
+}
+
+/*! \fn double *map_double_array(char fname[], size_t *n, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_double_array. */
+double *map_double_array(char fname[], size_t *n, array_map_mode mode, array_map_advice advice)
+{
+	size_t  shape[1];
+	double *x = map_array_file(fname,1,shape,mode,advice);
+
+	*n = shape[0];
+	return x;
+}
+/*! \fn double *map_double_array(char fname[], int *n, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_double_array. */
+double *map_double_array(char fname[], int *n, array_map_mode mode, array_map_advice advice)
+{
+	size_t  ns;
+	double *x = map_double_array(fname,&ns,mode,advice);
+
+	*n = array_extent(ns);
+	return x;
+}
+
+/*! \fn void unmap_double_array(double *x, size_t n)
+ *  \brief Unmap an array from map_double_array. */
+void unmap_double_array(double *x, size_t n)
+{
+	unmap_array_file(x,n);
+}
+
+/*! \fn double **map_two_dimensional_array(char fname[], size_t *n, size_t *l, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_two_dimensional_array. */
+double **map_two_dimensional_array(char fname[], size_t *n, size_t *l, array_map_mode mode, array_map_advice advice)
+{
+	size_t   shape[2];
+	double  *data = map_array_file(fname,2,shape,mode,advice);
+	double **x;
+
+	*n = shape[0];
+	*l = shape[1];
+	x  = new double *[*n];
+	for(size_t i=0;i<*n;i++)
+		x[i] = data + i*(*l);
+
+	//no row points at the mapping if n==0, so release it here
+	if(*n==0)
+		unmap_array_file(data,0);
+
+	return x;
+}
+/*! \fn double **map_two_dimensional_array(char fname[], int *n, int *l, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_two_dimensional_array. */
+double **map_two_dimensional_array(char fname[], int *n, int *l, array_map_mode mode, array_map_advice advice)
+{
+	size_t   ns, ls;
+	double **x = map_two_dimensional_array(fname,&ns,&ls,mode,advice);
+
+	*n = array_extent(ns);
+	*l = array_extent(ls);
+	return x;
+}
+
+/*! \fn void unmap_two_dimensional_array(double **x, size_t n, size_t l)
+ *  \brief Unmap an array from map_two_dimensional_array. */
+void unmap_two_dimensional_array(double **x, size_t n, size_t l)
+{
+	if(n>0)
+		unmap_array_file(x[0],n*l);
+	delete[] x;
+}
+
+/*! \fn double ***map_three_dimensional_array(char fname[], size_t *n, size_t *l, size_t *m, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_three_dimensional_array. */
+double ***map_three_dimensional_array(char fname[], size_t *n, size_t *l, size_t *m, array_map_mode mode, array_map_advice advice)
+{
+	size_t    shape[3];
+	double   *data = map_array_file(fname,3,shape,mode,advice);
+	double ***x;
+	double  **rows;
+	size_t    nl;
+
+	*n   = shape[0];
+	*l   = shape[1];
+	*m   = shape[2];
+	nl   = shape[0]*shape[1];
+	x    = new double **[*n];
+	rows = new double  *[nl];
+	for(size_t j=0;j<nl;j++)
+		rows[j] = data + j*(*m);
+	for(size_t i=0;i<*n;i++)
+		x[i] = rows + i*(*l);
+
+	if(nl==0)
+		unmap_array_file(data,0);
+	if(*n==0)
+		delete[] rows;
+
+	return x;
+}
+/*! \fn double ***map_three_dimensional_array(char fname[], int *n, int *l, int *m, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_three_dimensional_array. */
+double ***map_three_dimensional_array(char fname[], int *n, int *l, int *m, array_map_mode mode, array_map_advice advice)
+{
+	size_t    ns, ls, ms;
+	double ***x = map_three_dimensional_array(fname,&ns,&ls,&ms,mode,advice);
+
+	*n = array_extent(ns);
+	*l = array_extent(ls);
+	*m = array_extent(ms);
+	return x;
+}
+
+/*! \fn void unmap_three_dimensional_array(double ***x, size_t n, size_t l, size_t m)
+ *  \brief Unmap an array from map_three_dimensional_array. */
+void unmap_three_dimensional_array(double ***x, size_t n, size_t l, size_t m)
+{
+	if(n>0)
+	{
+		if(l>0)
+			unmap_array_file(x[0][0],n*l*m);
+		delete[] x[0];
+	}
+	delete[] x;
+}
+
+
+/*! \fn int compare_doubles(const void *a, const void *b)
+ *  \brief Function to compare doubles, for use with qsort.
+ */
+int compare_doubles(const void *a, const void *b)
+{
+	//compare doubles, from GNU C Library Ref. Manual
+	const double *da = (const double *) a;
+	const double *db = (const double *) b;
+	return (*da > *db) - (*da < *db);
+}
+
+
+
+
+/* Sorting.
+
+   array_sort is a least significant digit radix sort, eight passes of
+   one byte, on keys made from the bits of each double: positive values
+   get their sign bit set and negative values have every bit flipped, so
+   that unsigned order of the keys is numerical order (with -0 before
+   +0, which compare_doubles treats as equal).  A pass is skipped when
+   every key has the same digit there, as is common for the exponent
+   bytes.  compare_doubles treats a NaN as equal to everything, which
+   leaves qsort free to put it anywhere; here NaNs are moved, in their
+   original order, to the end. */
+
+/*! \def ROUTINES_SORT_SMALL
+ *  \brief Arrays up to this size are insertion sorted rather than radix sorted. */
+#define ROUTINES_SORT_SMALL 64
+
+/*! \fn static inline uint64_t sort_key(double x)
+ *  \brief Key whose unsigned order is the numerical order of x. */
+static inline uint64_t sort_key(double x)
+{
+	uint64_t u;
+
+	memcpy(&u,&x,sizeof(u));
+	return (u>>63) ? ~u : u | (1ULL<<63);
+}
+
+/*! \fn static inline double sort_value(uint64_t u)
+ *  \brief Inverse of sort_key. */
+static inline double sort_value(uint64_t u)
+{
+	double x;
+
+	u = (u>>63) ? u & ~(1ULL<<63) : ~u;
+	memcpy(&x,&u,sizeof(x));
+	return x;
+}
+
+/*! \fn static uint64_t *sort_keys_load(double *x, size_t n, size_t *m)
+ *  \brief Keys of the m non-NaN elements of x, with the NaNs shifted
+ *         in order to x[m..n-1]. */
+static uint64_t *sort_keys_load(double *x, size_t n, size_t *m)
+{
+	uint64_t *a = (uint64_t *) calloc_aligned(n,sizeof(uint64_t),ROUTINES_ALIGNMENT);
+	size_t k = 0, j = 0;
+
+	for(size_t i=0;i<n;i++)
+	{
+		if(isnan(x[i]))
+			x[j++] = x[i];
+		else
+			a[k++] = sort_key(x[i]);
+	}
+	//x[0..j) now holds the NaNs; move them to the end
+	memmove(x+n-j,x,j*sizeof(double));
+	*m = k;
+	return a;
+}
+
+/*! \fn static void sort_keys_store(double *x, const uint64_t *a, size_t m)
+ *  \brief Write the values of m sorted keys back into x. */
+static void sort_keys_store(double *x, const uint64_t *a, size_t m)
+{
+	for(size_t i=0;i<m;i++)
+		x[i] = sort_value(a[i]);
+}
+
+/*! \fn static void sort_keys_insertion(uint64_t *a, size_t m)
+ *  \brief Insertion sort of m keys. */
+static void sort_keys_insertion(uint64_t *a, size_t m)
+{
+	for(size_t i=1;i<m;i++)
+	{
+		uint64_t u = a[i];
+		size_t j = i;
+		for(;j>0 && a[j-1]>u;j--)
+			a[j] = a[j-1];
+		a[j] = u;
+	}
+}
+
+/*! \fn static bool sort_pass_needed(const size_t *count, size_t m)
+ *  \brief False if a single one of the 256 digit counts holds all m keys. */
+static bool sort_pass_needed(const size_t *count, size_t m)
+{
+	for(int d=0;d<256;d++)
+		if(count[d])
+			return count[d]!=m;
+	return false;
+}
+
+/*! \fn void array_sort(double *x, size_t n)
+ *  \brief Sort x into ascending order, NaNs last. */
+void array_sort(double *x, size_t n)
+{
+	size_t    count[8][256];
+	size_t    offset[256];
+	uint64_t *a, *b, *t;
+	size_t    m;
+
+	if(n<2)
+		return;
+
+	a = sort_keys_load(x,n,&m);
+	if(m<=ROUTINES_SORT_SMALL)
+	{
+		sort_keys_insertion(a,m);
+		sort_keys_store(x,a,m);
+		free_aligned(a);
+		return;
+	}
+
+	//histogram every digit in one read of the keys
+	memset(count,0,sizeof(count));
+	for(size_t i=0;i<m;i++)
+		for(int p=0;p<8;p++)
+			count[p][(a[i]>>(8*p)) & 0xff]++;
+
+	b = (uint64_t *) calloc_aligned(m,sizeof(uint64_t),ROUTINES_ALIGNMENT);
+	for(int p=0;p<8;p++)
+	{
+		if(!sort_pass_needed(count[p],m))
+			continue;
+
+		size_t sum = 0;
+		for(int d=0;d<256;d++)
+		{
+			offset[d] = sum;
+			sum      += count[p][d];
+		}
+		for(size_t i=0;i<m;i++)
+			b[offset[(a[i]>>(8*p)) & 0xff]++] = a[i];
+
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	sort_keys_store(x,a,m);
+	free_aligned(a);
+	free_aligned(b);
+}
+
+/*! \fn void array_sort_parallel(double *x, size_t n)
+ *  \brief Sort x into ascending order, NaNs last, using OpenMP threads. */
+void array_sort_parallel(double *x, size_t n)
+{
+	uint64_t *a, *b, *t;
+	size_t   *count;
+	size_t    total[8][256];
+	size_t    m;
+	int       nthreads = 1;
+
+	if(n<ROUTINES_PARALLEL_CHUNK)
+	{
+		array_sort(x,n);
+		return;
+	}
+
+	a = sort_keys_load(x,n,&m);
+	b = (uint64_t *) calloc_aligned(m,sizeof(uint64_t),ROUTINES_ALIGNMENT);
+
+#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+#endif
+	//count[(thread*8 + pass)*256 + digit]
+	count = (size_t *) calloc_aligned((size_t) nthreads*8*256,sizeof(size_t),ROUTINES_ALIGNMENT);
+	memset(total,0,sizeof(total));
+
+	//each thread scatters one contiguous range of the keys in
+	//every pass; the ranges of different threads land in order
+	//within each digit, so the sort stays stable
+	#pragma omp parallel num_threads(nthreads)
+	{
+		int tid = 0, nt = 1;
+#ifdef _OPENMP
+		tid = omp_get_thread_num();
+		nt  = omp_get_num_threads();
+#endif
+		size_t lo = m*tid/nt;
+		size_t hi = m*(tid+1)/nt;
+		size_t *c = count + (size_t) tid*8*256;
+
+		//the totals of every digit do not change between
+		//passes, so are taken once to find passes to skip
+		for(size_t i=lo;i<hi;i++)
+			for(int p=0;p<8;p++)
+				c[p*256 + ((a[i]>>(8*p)) & 0xff)]++;
+		#pragma omp barrier
+
+		#pragma omp single
+		for(int r=0;r<nt;r++)
+			for(int q=0;q<8*256;q++)
+				total[q/256][q%256] += count[(size_t) r*8*256 + q];
+
+		for(int p=0;p<8;p++)
+		{
+			if(!sort_pass_needed(total[p],m))
+				continue;
+
+			//this thread's digit counts for this pass
+			size_t *o = c + p*256;
+			memset(o,0,256*sizeof(size_t));
+			for(size_t i=lo;i<hi;i++)
+				o[(a[i]>>(8*p)) & 0xff]++;
+			#pragma omp barrier
+
+			//turn them into the position of the thread's
+			//first key with each digit
+			#pragma omp single
+			{
+				size_t sum = 0;
+				for(int d=0;d<256;d++)
+					for(int r=0;r<nt;r++)
+					{
+						size_t *q = count + ((size_t) r*8 + p)*256 + d;
+						size_t  k = *q;
+						*q   = sum;
+						sum += k;
+					}
+			}
+
+			for(size_t i=lo;i<hi;i++)
+				b[o[(a[i]>>(8*p)) & 0xff]++] = a[i];
+			#pragma omp barrier
+
+			#pragma omp single
+			{
+				t = a;
+				a = b;
+				b = t;
+			}
+		}
+	}
+
+	sort_keys_store(x,a,m);
+	free_aligned(a);
+	free_aligned(b);
+	free_aligned(count);
+}
+
+/*! \fn double time_in_seconds(clock_t A, clock_t B)
+ *  \brief Returns time difference B-A in seconds for two clock_t
+ */
+double time_in_seconds(clock_t A, clock_t B)
+{
+	return ((double) (B - A))/((double) CLOCKS_PER_SEC);
+}
+
+/*! \fn double wall_time(void)
+ *  \brief Seconds on a monotonic clock with ns resolution */
+double wall_time(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (double) t.tv_sec + 1.0e-9*t.tv_nsec;
+}
+
+/*! \fn double thread_cpu_time(void)
+ *  \brief CPU seconds used so far by the calling thread */
+double thread_cpu_time(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID,&t);
+	return (double) t.tv_sec + 1.0e-9*t.tv_nsec;
+}
+
+/* Each region keeps one slot per thread, a cache line or more apart, so
+   recording an interval is a few relaxed loads and stores by the only
+   thread that writes the slot.  The atomics only make the concurrent
+   reads in timer_summary well defined.  A thread takes its slot index
+   on its first interval and gives it back when it exits, so a process
+   that keeps starting threads reuses the slots; only threads beyond
+   ROUTINES_TIMER_THREADS alive at once share the last slot under the
+   region's lock.  A reused slot carries on from the statistics of the
+   thread that left it, which is all the summary needs. */
+struct alignas(64) timer_slot
+{
+	std::atomic<size_t> count;
+	std::atomic<double> total;
+	std::atomic<double> min;
+	std::atomic<double> max;
+	std::atomic<double> cpu;
+};
+
+struct timer_region
+{
+	timer_slot    slot[ROUTINES_TIMER_THREADS+1];
+	std::mutex    lock;
+	char         *name;
+	bool          cpu_time;
+	timer_region *next;
+};
+
+static std::mutex        timer_lock;
+static timer_region     *timer_regions = NULL;
+static bool              timer_at_exit = true;
+
+static std::mutex        timer_slot_lock;
+static int               timer_slot_free[ROUTINES_TIMER_THREADS];
+static int               timer_slot_nfree = 0;
+static int               timer_threads    = 0;
+
+/*! \fn static int timer_slot_acquire(void)
+ *  \brief Slot index for a thread: a returned one, else a fresh one,
+ *         else the shared slot ROUTINES_TIMER_THREADS. */
+static int timer_slot_acquire(void)
+{
+	std::lock_guard<std::mutex> guard(timer_slot_lock);
+
+	if(timer_slot_nfree>0)
+		return timer_slot_free[--timer_slot_nfree];
+	if(timer_threads<ROUTINES_TIMER_THREADS)
+		return timer_threads++;
+	return ROUTINES_TIMER_THREADS;
+}
+
+/*! \struct timer_thread
+ *  \brief A thread's slot index, given back by its destructor at thread exit. */
+struct timer_thread
+{
+	int tid;
+
+	timer_thread() : tid(-1) {}
+	~timer_thread()
+	{
+		if(tid<0 || tid==ROUTINES_TIMER_THREADS)
+			return;
+		std::lock_guard<std::mutex> guard(timer_slot_lock);
+		timer_slot_free[timer_slot_nfree++] = tid;
+	}
+};
+
+/*! \fn static void timer_slot_clear(timer_slot *s)
+ *  \brief Zero the statistics of a slot. */
+static void timer_slot_clear(timer_slot *s)
+{
+	s->count.store(0,std::memory_order_relaxed);
+	s->total.store(0,std::memory_order_relaxed);
+	s->min.store(0,std::memory_order_relaxed);
+	s->max.store(0,std::memory_order_relaxed);
+	s->cpu.store(0,std::memory_order_relaxed);
+}
+
+/*! \fn static void timer_summary_exit(void)
+ *  \brief Print the summary at exit unless disabled. */
+static void timer_summary_exit(void)
+{
+	if(timer_at_exit)
+		timer_summary(stdout);
+}
+
+/*! \fn timer_region *timer_region_get(const char *name, bool cpu_time)
+ *  \brief Return the region called name, creating it on first use */
+timer_region *timer_region_get(const char *name, bool cpu_time)
+{
+	std::lock_guard<std::mutex> guard(timer_lock);
+	timer_region *r, **tail = &timer_regions;
+
+	for(r=timer_regions;r;r=r->next)
+	{
+		if(!strcmp(r->name,name))
+		{
+			r->cpu_time = r->cpu_time || cpu_time;
+			return r;
+		}
+		tail = &r->next;
+	}
+
+	if(!timer_regions)
+		atexit(timer_summary_exit);
+
+	r = new (calloc_aligned(1,sizeof(timer_region),ROUTINES_ALIGNMENT)) timer_region;
+	for(int t=0;t<=ROUTINES_TIMER_THREADS;t++)
+		timer_slot_clear(&r->slot[t]);
+	if(!(r->name = (char *) malloc(strlen(name)+1)))
+	{
+		printf("Error allocating timer region %s.\n",name);
+		fflush(stdout);
+		exit(-1);
+	}
+	strcpy(r->name,name);
+	r->cpu_time = cpu_time;
+	r->next     = NULL;
+	*tail       = r;
+	return r;
+}
+
+/*! \fn bool timer_region_cpu_time(const timer_region *r)
+ *  \brief True if r records thread CPU time */
+bool timer_region_cpu_time(const timer_region *r)
+{
+	return r->cpu_time;
+}
+
+/*! \fn void timer_region_add(timer_region *r, double wall, double cpu)
+ *  \brief Record one interval of wall seconds, and cpu CPU seconds, in r */
+void timer_region_add(timer_region *r, double wall, double cpu)
+{
+	static thread_local timer_thread self;
+	const std::memory_order relaxed = std::memory_order_relaxed;
+	int tid = self.tid;
+
+	if(tid<0)
+		tid = self.tid = timer_slot_acquire();
+
+	timer_slot *s = &r->slot[tid];
+	std::unique_lock<std::mutex> guard(r->lock,std::defer_lock);
+	if(tid==ROUTINES_TIMER_THREADS)
+		guard.lock();
+
+	size_t n = s->count.load(relaxed);
+	s->total.store(s->total.load(relaxed) + wall,relaxed);
+	s->cpu.store(s->cpu.load(relaxed) + cpu,relaxed);
+	if(n==0 || wall<s->min.load(relaxed))
+		s->min.store(wall,relaxed);
+	if(n==0 || wall>s->max.load(relaxed))
+		s->max.store(wall,relaxed);
+	s->count.store(n+1,relaxed);
+}
+
+/*! \fn void timer_summary(FILE *fp)
+ *  \brief Print count, total, mean, min and max of every region to fp */
+void timer_summary(FILE *fp)
+{
+	std::lock_guard<std::mutex> guard(timer_lock);
+	const std::memory_order relaxed = std::memory_order_relaxed;
+
+	if(!timer_regions)
+		return;
+
+	fprintf(fp,"%-32s %12s %12s %12s %12s %12s %12s\n","timer region","count","total [s]","mean [s]","min [s]","max [s]","cpu [s]");
+	for(timer_region *r=timer_regions;r;r=r->next)
+	{
+		size_t count = 0;
+		double total = 0, cpu = 0, min = 0, max = 0;
+
+		for(int t=0;t<=ROUTINES_TIMER_THREADS;t++)
+		{
+			timer_slot *s = &r->slot[t];
+			size_t      n = s->count.load(relaxed);
+
+			if(n==0)
+				continue;
+			min    = (count==0) ? s->min.load(relaxed) : GSL_MIN(min,s->min.load(relaxed));
+			max    = (count==0) ? s->max.load(relaxed) : GSL_MAX(max,s->max.load(relaxed));
+			count += n;
+			total += s->total.load(relaxed);
+			cpu   += s->cpu.load(relaxed);
+		}
+		if(r->cpu_time)
+			fprintf(fp,"%-32s %12zu %12.6e %12.6e %12.6e %12.6e %12.6e\n",r->name,count,total,count ? total/count : 0.0,min,max,cpu);
+		else
+			fprintf(fp,"%-32s %12zu %12.6e %12.6e %12.6e %12.6e %12s\n",r->name,count,total,count ? total/count : 0.0,min,max,"-");
+	}
+	fflush(fp);
+}
+
+/*! \fn void timer_summary_at_exit(bool enable)
+ *  \brief Choose whether timer_summary(stdout) is printed at exit */
+void timer_summary_at_exit(bool enable)
+{
+	std::lock_guard<std::mutex> guard(timer_lock);
+	timer_at_exit = enable;
+}
+
+/*! \fn void timer_reset(void)
+ *  \brief Zero the statistics of every region */
+void timer_reset(void)
+{
+	std::lock_guard<std::mutex> guard(timer_lock);
+
+	for(timer_region *r=timer_regions;r;r=r->next)
+		for(int t=0;t<=ROUTINES_TIMER_THREADS;t++)
+			timer_slot_clear(&r->slot[t]);
+}
+
+/*! \fn static void spline_nodes_evaluate(double (*func)(double, void *), double *x, double *y, int n, double *params, bool log10x, int max_threads)
+ *  \brief Fill y[i] = func(x[i],params), or func(10^x[i],params) if log10x.
+ *         With max_threads != 1 the nodes are shared dynamically among
+ *         OpenMP threads, at most max_threads of them if max_threads > 0. */
+static void spline_nodes_evaluate(double (*func)(double, void *), double *x, double *y, int n, double *params, bool log10x, int max_threads)
+{
+	if(max_threads==1)
+	{
+		for(int i=0;i<n;i++)
+			y[i] = func(log10x ? pow(10.0,x[i]) : x[i],params);
+		return;
+	}
+
+#ifdef _OPENMP
+	int nthreads = omp_get_max_threads();
+	if(max_threads>0 && max_threads<nthreads)
+		nthreads = max_threads;
+#endif
+
+	//func may cost very different amounts across the table,
+	//so hand out nodes one at a time
+	#pragma omp parallel for schedule(dynamic,1) num_threads(nthreads)
+	for(int i=0;i<n;i++)
+		y[i] = func(log10x ? pow(10.0,x[i]) : x[i],params);
+}
+
+/*! \fn static void spline_log10_values(double *log10x, double *log10y, int n)
+ *  \brief Replace func(x) in log10y with log10(func(x)), refusing
+ *         non-positive values. */
+static void spline_log10_values(double *log10x, double *log10y, int n)
+{
+	for(int i=0;i<n;i++)
+	{
+		if(log10y[i]<=0)
+		{
+			printf("func(%e) <= 0 (%e), cannot use log10 spline here.\n",pow(10.0,log10x[i]),log10y[i]);
+			fflush(stdout);
+			exit(-1);
+		}
+		log10y[i] = log10(log10y[i]);
+	}
+}
+
+/*! \fn void create_log10_spline(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
+ *  \brief Routine to make a spline, interpolating in log10.
+ */
+void create_log10_spline(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
+{
+	create_log10_spline_parallel(func,log10x,log10y,n,params,spline,acc,1);
+}
+
+/*! \fn void create_log10_spline_parallel(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief Routine to make a spline, interpolating in log10, evaluating
+ *         func at the nodes concurrently.
+ */
+void create_log10_spline_parallel(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+{
+	//log10x contains the locations at which
+	//wish to evaluate the function func()
+
+	//log10y is input unallocated
+	//we will allocate it and it will
+	//contain log10(func(x))
+
+	//n is the size of the array of log10x and log10y
+	
+	//params is the array of parameters to pass to
+	//func(x,params)
+
+	//spline is the unallocated gsl_spline
+
+	//acc is the unallocated gsl_interp_accel
+
+	//max_threads caps the number of threads
+	//calling func, 0 for the OpenMP default
+
+	//allocate log10y
+	log10y = calloc_double_array(n);
+
+	//evaluate func at x locations, then
+	//check and take the log serially so
+	//any error is reported for the first node
+	spline_nodes_evaluate(func,log10x,log10y,n,params,true,max_threads);
+	spline_log10_values(log10x,log10y,n);
+
+
+	//allocate interpolants
+	spline = gsl_spline_alloc(gsl_interp_cspline,n);
+
+	acc    = gsl_interp_accel_alloc();
+
+	//create interpoolation
+	gsl_spline_init(spline, log10x, log10y, n);
+}
+
+/*! \fn void create_linear_spline(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
+ *  \brief Routine to create a spline, interpolated linear.
+ */
+void create_linear_spline(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
+{
+	create_linear_spline_parallel(func,x,y,n,params,spline,acc,1);
+}
+
+/*! \fn void create_linear_spline_parallel(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief Routine to create a spline, interpolated linear, evaluating
+ *         func at the nodes concurrently.
+ */
+void create_linear_spline_parallel(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+{
+	//x contains the locations at which
+	//wish to evaluate the function func()
+
+	//y is input unallocated
+	//we will allocate it and it will
+	//contain func(x)
+
+	//n is the size of the array of x and y
+	
+	//params is the array of parameters to pass to
+	//func(x,params)
+
+	//spline is the unallocated gsl_spline
+
+	//acc is the unallocated gsl_interp_accel
+
+	//max_threads caps the number of threads
+	//calling func, 0 for the OpenMP default
+
+	//allocate y
+	y = calloc_double_array(n);
+
+	//evaluate func at x locations
+	spline_nodes_evaluate(func,x,y,n,params,false,max_threads);
+
+
+	//allocate interpolants
+	spline = gsl_spline_alloc(gsl_interp_cspline,n);
+
+	acc    = gsl_interp_accel_alloc();
+
+	//create interpoolation
+	gsl_spline_init(spline, x, y, n);
+}
+
+/*! \fn static void spline_midpoints_evaluate(double (*func)(double, void *), double *xm, double *ym, int *fresh, int n, double *params, int max_threads, double *xe, double *ye)
+ *  \brief Set ym[i] = log10(func(10^xm[i])) wherever fresh[i], evaluating
+ *         all of them together in the scratch arrays xe and ye. */
+static void spline_midpoints_evaluate(double (*func)(double, void *), double *xm, double *ym, int *fresh, int n, double *params, int max_threads, double *xe, double *ye)
+{
+	int m = 0;
+
+	for(int i=0;i<n;i++)
+		if(fresh[i])
+			xe[m++] = xm[i];
+	spline_nodes_evaluate(func,xe,ye,m,params,true,max_threads);
+	spline_log10_values(xe,ye,m);
+	m = 0;
+	for(int i=0;i<n;i++)
+		if(fresh[i])
+			ym[i] = ye[m++];
+}
+
+/*! \fn double create_log10_spline_adaptive(double (*func)(double, void *), double log10xmin, double log10xmax, double tol, double *&log10x, double *&log10y, int &n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int n_max, int max_threads)
+ *  \brief Routine to make a spline, interpolating in log10, with nodes
+ *         placed adaptively until the interpolation error is below tol.
+ */
+double create_log10_spline_adaptive(double (*func)(double, void *), double log10xmin, double log10xmax, double tol, double *&log10x, double *&log10y, int &n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int n_max, int max_threads)
+{
+	//log10x and log10y are input unallocated
+	//and returned holding the final table
+
+	//n is the size of the coarse starting grid
+	//on input and of the final table on output
+
+	//every interval's midpoint is evaluated once;
+	//an interval whose midpoint the spline misses
+	//by more than tol (in log10 func) is split there,
+	//reusing the midpoint as a node, until no interval
+	//needs splitting or the table holds n_max nodes
+
+	double *x[2], *y[2];	//nodes, current and next
+	double *xm[2], *ym[2];	//midpoint of every interval
+	int    *fresh[2];	//midpoints not yet evaluated
+	double *xe, *ye;
+	int    *split;
+	int     n_split, c = 0, k;
+	double  err, err_max;
+	gsl_spline       *s;
+	gsl_interp_accel *a;
+
+	if(n<3 || n_max<n || !(log10xmax>log10xmin))
+	{
+		printf("Error: create_log10_spline_adaptive needs 3 <= n <= n_max and log10xmax > log10xmin (n = %d, n_max = %d).\n",n,n_max);
+		fflush(stdout);
+		exit(-1);
+	}
+
+	for(int j=0;j<2;j++)
+	{
+		x[j]     = calloc_double_array(n_max);
+		y[j]     = calloc_double_array(n_max);
+		xm[j]    = calloc_double_array(n_max);
+		ym[j]    = calloc_double_array(n_max);
+		fresh[j] = calloc_int_array(n_max);
+	}
+	xe    = calloc_double_array(n_max);
+	ye    = calloc_double_array(n_max);
+	split = calloc_int_array(n_max);
+
+	//the coarse grid, and its intervals' midpoints
+	fill_linear_grid(x[c],n,log10xmin,log10xmax);
+	spline_nodes_evaluate(func,x[c],y[c],n,params,true,max_threads);
+	spline_log10_values(x[c],y[c],n);
+	for(int i=0;i<n-1;i++)
+	{
+		xm[c][i]    = 0.5*(x[c][i] + x[c][i+1]);
+		fresh[c][i] = 1;
+	}
+	spline_midpoints_evaluate(func,xm[c],ym[c],fresh[c],n-1,params,max_threads,xe,ye);
+
+	a = gsl_interp_accel_alloc();
+	for(;;)
+	{
+		//measure the error at every midpoint
+		s = gsl_spline_alloc(gsl_interp_cspline,n);
+		gsl_spline_init(s,x[c],y[c],n);
+		gsl_interp_accel_reset(a);
+		err_max = 0;
+		n_split = 0;
+		for(int i=0;i<n-1;i++)
+		{
+			err = fabs(gsl_spline_eval(s,xm[c][i],a) - ym[c][i]);
+			if(!(err<=err_max))
+				err_max = err;
+			split[i] = !(err<=tol) && n+n_split<n_max;
+			n_split += split[i];
+		}
+		gsl_spline_free(s);
+
+		if(n_split==0)
+			break;
+
+		//copy the table into the other buffers, turning the
+		//midpoint of each split interval into a node; the two
+		//halves of a split interval have fresh midpoints
+		k = 0;
+		for(int i=0;i<n-1;i++)
+		{
+			x[1-c][k] = x[c][i];
+			y[1-c][k] = y[c][i];
+			if(split[i])
+			{
+				xm[1-c][k]    = 0.5*(x[c][i] + xm[c][i]);
+				fresh[1-c][k] = 1;
+				k++;
+				x[1-c][k]     = xm[c][i];
+				y[1-c][k]     = ym[c][i];
+				xm[1-c][k]    = 0.5*(xm[c][i] + x[c][i+1]);
+				fresh[1-c][k] = 1;
+			}else{
+				xm[1-c][k]    = xm[c][i];
+				ym[1-c][k]    = ym[c][i];
+				fresh[1-c][k] = 0;
+			}
+			k++;
+		}
+		x[1-c][k] = x[c][n-1];
+		y[1-c][k] = y[c][n-1];
+		n = k+1;
+		c = 1-c;
+
+		spline_midpoints_evaluate(func,xm[c],ym[c],fresh[c],n-1,params,max_threads,xe,ye);
+	}
+	gsl_interp_accel_free(a);
+
+	//return the final, compact table
+	log10x = calloc_double_array(n);
+	log10y = calloc_double_array(n);
+	memcpy(log10x,x[c],n*sizeof(double));
+	memcpy(log10y,y[c],n*sizeof(double));
+	for(int j=0;j<2;j++)
+	{
+		free(x[j]);
+		free(y[j]);
+		free(xm[j]);
+		free(ym[j]);
+		free(fresh[j]);
+	}
+	free(xe);
+	free(ye);
+	free(split);
+
+	//allocate interpolants
+	spline = gsl_spline_alloc(gsl_interp_cspline,n);
+
+	acc    = gsl_interp_accel_alloc();
+
+	//create interpolation
+	gsl_spline_init(spline, log10x, log10y, n);
+
+	return err_max;
+}
+
+/* Shared spline evaluation.
+
+   gsl_spline_eval only reads the spline; the one piece of mutable state
+   is the gsl_interp_accel holding the index of the last interval found.
+   spline_eval keeps a few accelerators per thread, in thread-local
+   storage, each tagged with the spline it belongs to, so threads never
+   share one.  A tag records the address and size of the spline: an
+   accelerator's cached index is only ever compared against the node
+   array, so it remains safe even if a spline is freed and another
+   allocated at the same address. */
+
+/*! \def ROUTINES_SPLINE_ACCEL_SLOTS
+ *  \brief Number of splines per thread that keep their own accelerator. */
+#define ROUTINES_SPLINE_ACCEL_SLOTS 4
+
+/*! \struct spline_accel_slot
+ *  \brief One thread-local accelerator and the spline it belongs to. */
+struct spline_accel_slot
+{
+	const gsl_spline *spline;
+	size_t            size;
+	gsl_interp_accel  acc;
+};
+
+/*! \fn static gsl_interp_accel *spline_accel(const gsl_spline *spline)
+ *  \brief This thread's accelerator for spline, recycling the least
+ *         recently claimed slot for a spline not seen before. */
+static gsl_interp_accel *spline_accel(const gsl_spline *spline)
+{
+	static thread_local spline_accel_slot slot[ROUTINES_SPLINE_ACCEL_SLOTS];
+	static thread_local int next = 0;
+	spline_accel_slot *a;
+
+	for(int i=0;i<ROUTINES_SPLINE_ACCEL_SLOTS;i++)
+		if(slot[i].spline==spline && slot[i].size==spline->size)
+			return &slot[i].acc;
+
+	a = &slot[next];
+	next = (next+1) % ROUTINES_SPLINE_ACCEL_SLOTS;
+	a->spline = spline;
+	a->size   = spline->size;
+	gsl_interp_accel_reset(&a->acc);
+	return &a->acc;
+}
+
+/*! \fn double spline_eval(const gsl_spline *spline, double x)
+ *  \brief Evaluate spline at x; safe to call from many threads at once. */
+double spline_eval(const gsl_spline *spline, double x)
+{
+	return gsl_spline_eval(spline,x,spline_accel(spline));
+}
+
+/*! \fn void spline_eval_many(const gsl_spline *spline, const double *x, int n, double *y)
+ *  \brief Evaluate spline at n points, y[i] = spline(x[i]); safe to call
+ *         from many threads at once. */
+void spline_eval_many(const gsl_spline *spline, const double *x, int n, double *y)
+{
+	gsl_interp_accel *acc = spline_accel(spline);
+
+	for(int i=0;i<n;i++)
+		y[i] = gsl_spline_eval(spline,x[i],acc);
+}
+
+/* Spline cache.
+
+   A cache file holds one table: a spline_cache_header followed by the
+   n nodes x[] and the n values y[] (log10 of func for log10 splines),
+   as native doubles.  It is named <cache_dir>/<func_id>-<key>.spline,
+   where key is a 64-bit FNV-1a hash of the spline kind, params and the
+   node grid.  On a hit the file is mapped read-only, checked against
+   the requested grid and its values copied into y; the spline itself
+   is then built from them by gsl_spline_init as usual, which is linear
+   in n.  Files are written to a unique temporary name from mkstemp and
+   renamed into place, so concurrent threads and jobs never map a
+   partial table.  Any failure to read or
+   write the cache just falls back to evaluating func. */
+
+#define ROUTINES_SPLINE_CACHE_MAGIC "BRSPLINE"
+#define ROUTINES_SPLINE_CACHE_VERSION 1
+
+/*! \struct spline_cache_header
+ *  \brief Leading record of a spline cache file. */
+struct spline_cache_header
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t log10;
+	uint64_t key;
+	uint64_t n;
+};
+
+/*! \fn static uint64_t spline_cache_hash(uint64_t h, const void *p, size_t size)
+ *  \brief Fold size bytes at p into the FNV-1a hash h. */
+static uint64_t spline_cache_hash(uint64_t h, const void *p, size_t size)
+{
+	const unsigned char *c = (const unsigned char *) p;
+
+	for(size_t i=0;i<size;i++)
+	{
+		h ^= c[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/*! \fn static uint64_t spline_cache_key(double *x, int n, double *params, int n_params, bool log10)
+ *  \brief Hash of everything besides func that determines a table. */
+static uint64_t spline_cache_key(double *x, int n, double *params, int n_params, bool log10)
+{
+	uint64_t h    = 14695981039346656037ULL;
+	uint32_t kind = log10;
+
+	h = spline_cache_hash(h,&kind,sizeof(kind));
+	h = spline_cache_hash(h,&n_params,sizeof(int));
+	h = spline_cache_hash(h,params,n_params*sizeof(double));
+	h = spline_cache_hash(h,&n,sizeof(int));
+	return spline_cache_hash(h,x,n*sizeof(double));
+}
+
+/*! \fn static bool spline_cache_read(const char *fname, uint64_t key, double *x, double *y, int n, bool log10)
+ *  \brief Copy the cached values into y if fname holds the table for key
+ *         and the grid x; return false otherwise. */
+static bool spline_cache_read(const char *fname, uint64_t key, double *x, double *y, int n, bool log10)
+{
+	spline_cache_header h;
+	struct stat st;
+	size_t size = sizeof(h) + 2*(size_t) n*sizeof(double);
+	bool   hit  = false;
+	void  *map;
+	int    fd;
+
+	if((fd = open(fname,O_RDONLY))<0)
+		return false;
+	if(fstat(fd,&st)!=0 || (size_t) st.st_size!=size)
+	{
+		close(fd);
+		return false;
+	}
+	map = mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(map==MAP_FAILED)
+		return false;
+
+	//the full grid is compared, not just the hash,
+	//so a collision cannot return the wrong table
+	memcpy(&h,map,sizeof(h));
+	const double *cx = (const double *) ((const char *) map + sizeof(h));
+	if(memcmp(h.magic,ROUTINES_SPLINE_CACHE_MAGIC,8)==0 && h.version==ROUTINES_SPLINE_CACHE_VERSION &&
+	   h.log10==(uint32_t) log10 && h.key==key && h.n==(uint64_t) n &&
+	   memcmp(cx,x,n*sizeof(double))==0)
+	{
+		memcpy(y,cx+n,n*sizeof(double));
+		hit = true;
+	}
+	munmap(map,size);
+	return hit;
+}
+
+/*! \fn static void spline_cache_write(const char *fname, uint64_t key, double *x, double *y, int n, bool log10)
+ *  \brief Store a table under fname, replacing any existing file atomically. */
+static void spline_cache_write(const char *fname, uint64_t key, double *x, double *y, int n, bool log10)
+{
+	spline_cache_header h;
+	char  tmp[FILENAME_MAX+32];
+	FILE *fp;
+	bool  ok;
+	int   fd;
+
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,ROUTINES_SPLINE_CACHE_MAGIC,8);
+	h.version = ROUTINES_SPLINE_CACHE_VERSION;
+	h.log10   = log10;
+	h.key     = key;
+	h.n       = n;
+
+	//a unique name beside fname, so that no other thread or host
+	//sharing cache_dir can write or remove it, and rename is atomic;
+	//mkstemp creates it 0600, but other jobs must be able to read it
+	snprintf(tmp,sizeof(tmp),"%s.XXXXXX",fname);
+	if((fd = mkstemp(tmp))<0)
+		return;
+	if(fchmod(fd,0644)!=0 || !(fp = fdopen(fd,"wb")))
+	{
+		close(fd);
+		remove(tmp);
+		return;
+	}
+	ok  = fwrite(&h,sizeof(h),1,fp)==1;
+	ok &= fwrite(x,sizeof(double),n,fp)==(size_t) n;
+	ok &= fwrite(y,sizeof(double),n,fp)==(size_t) n;
+	ok &= fclose(fp)==0;
+	if(!ok || rename(tmp,fname)!=0)
+		remove(tmp);
+}
+
+/*! \fn static void create_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *x, double *&y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads, bool log10)
+ *  \brief Shared body of create_linear_spline_cached and create_log10_spline_cached. */
+static void create_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *x, double *&y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads, bool log10)
+{
+	char     fname[FILENAME_MAX];
+	uint64_t key = spline_cache_key(x,n,params,n_params,log10);
+
+	snprintf(fname,sizeof(fname),"%s/%s-%016llx.spline",cache_dir,func_id,(unsigned long long) key);
+
+	y = calloc_double_array(n);
+	if(!spline_cache_read(fname,key,x,y,n,log10))
+	{
+		spline_nodes_evaluate(func,x,y,n,params,log10,max_threads);
+		if(log10)
+			spline_log10_values(x,y,n);
+		spline_cache_write(fname,key,x,y,n,log10);
+	}
+
+	//allocate interpolants
+	spline = gsl_spline_alloc(gsl_interp_cspline,n);
+
+	acc    = gsl_interp_accel_alloc();
+
+	//create interpolation
+	gsl_spline_init(spline, x, y, n);
+}
+
+/*! \fn void create_linear_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *x, double *&y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief Routine to create a spline, interpolated linear, reusing a
+ *         table cached on disk when one matches.
+ */
+void create_linear_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *x, double *&y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+{
+	create_spline_cached(cache_dir,func_id,func,x,y,n,params,n_params,spline,acc,max_threads,false);
+}
+
+/*! \fn void create_log10_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief Routine to make a spline, interpolating in log10, reusing a
+ *         table cached on disk when one matches.
+ */
+void create_log10_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+{
+	create_spline_cached(cache_dir,func_id,func,log10x,log10y,n,params,n_params,spline,acc,max_threads,true);
+}
+
+/* Uniform splines.
+
+   The natural cubic spline through n uniformly spaced nodes, the same
+   interpolant as gsl_interp_cspline.  The second derivatives m_i come
+   from the tridiagonal system m_{i-1} + 4 m_i + m_{i+1} = 6 (y_{i+1} -
+   2 y_i + y_{i-1}), written in units of the node spacing, with m_0 =
+   m_{n-1} = 0.  On interval i the spline is stored as the cubic
+   c0 + c1 s + c2 s^2 + c3 s^3 in the local coordinate s = (x-x_i)/dx,
+   so evaluation is one multiply to find u = (x-xmin)/dx, a truncation
+   to find i, and Horner's rule in u - i. */
+
+/*! \struct uniform_spline
+ *  \brief Coefficients of a natural cubic spline on a uniform grid. */
+struct uniform_spline
+{
+	double  xmin;
+	double  xmax;
+	double  inv_dx;
+	int     n;
+	double *c;
+};
+
+/*! \struct uniform_spline_float
+ *  \brief Coefficients of a natural cubic spline on a uniform grid, in float. */
+struct uniform_spline_float
+{
+	float   xmin;
+	float   xmax;
+	float   inv_dx;
+	int     n;
+	float  *c;
+};
+
+/*! \fn static double *uniform_spline_coefficients(const char *caller, double xmin, double xmax, const double *y, int n)
+ *  \brief The 4(n-1) interval coefficients of the spline through y[i],
+ *         after checking the arguments of caller. */
+static double *uniform_spline_coefficients(const char *caller, double xmin, double xmax, const double *y, int n)
+{
+	double *cs, *m, *w;
+	double  r;
+
+	if(n<2 || !(xmax>xmin))
+	{
+		printf("Error: %s needs n >= 2 and xmax > xmin (n = %d, xmin = %e, xmax = %e).\n",caller,n,xmin,xmax);
+		fflush(stdout);
+		exit(-1);
+	}
+	cs = (double *) calloc_aligned(4*(size_t) (n-1),sizeof(double),ROUTINES_ALIGNMENT);
+
+	//second derivatives by the Thomas algorithm;
+	//w holds the eliminated superdiagonal
+	m = calloc_double_array(n);
+	w = calloc_double_array(n);
+	for(int i=1;i<n-1;i++)
+	{
+		r    = 1.0/(4.0 - (i>1 ? w[i-1] : 0));
+		w[i] = r;
+		m[i] = (6.0*(y[i+1] - 2.0*y[i] + y[i-1]) - m[i-1])*r;
+	}
+	for(int i=n-3;i>=1;i--)
+		m[i] -= w[i]*m[i+1];
+
+	for(int i=0;i<n-1;i++)
+	{
+		double *c = cs + 4*(size_t) i;
+		c[0] = y[i];
+		c[1] = (y[i+1] - y[i]) - (2.0*m[i] + m[i+1])/6.0;
+		c[2] = 0.5*m[i];
+		c[3] = (m[i+1] - m[i])/6.0;
+	}
+
+	free(m);
+	free(w);
+	return cs;
+}
+
+/*! \fn uniform_spline *uniform_spline_alloc(double xmin, double xmax, const double *y, int n)
+ *  \brief Build a uniform spline through y[i] at x_i = xmin + i (xmax-xmin)/(n-1). */
+uniform_spline *uniform_spline_alloc(double xmin, double xmax, const double *y, int n)
+{
+	uniform_spline *s;
+	double *c = uniform_spline_coefficients("uniform_spline_alloc",xmin,xmax,y,n);
+
+	if(!(s = (uniform_spline *) malloc(sizeof(uniform_spline))))
+	{
+		printf("Error allocating uniform_spline.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	s->xmin   = xmin;
+	s->xmax   = xmax;
+	s->inv_dx = ((double) (n-1))/(xmax-xmin);
+	s->n      = n;
+	s->c      = c;
+	return s;
+}
+
+/*! \fn uniform_spline_float *uniform_spline_float_alloc(double xmin, double xmax, const double *y, int n)
+ *  \brief Build a float uniform spline through y[i] at x_i = xmin + i (xmax-xmin)/(n-1). */
+uniform_spline_float *uniform_spline_float_alloc(double xmin, double xmax, const double *y, int n)
+{
+	uniform_spline_float *s;
+	double *c  = uniform_spline_coefficients("uniform_spline_float_alloc",xmin,xmax,y,n);
+	size_t  nc = 4*(size_t) (n-1);
+
+	if(!(s = (uniform_spline_float *) malloc(sizeof(uniform_spline_float))))
+	{
+		printf("Error allocating uniform_spline_float.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+	s->xmin   = (float) xmin;
+	s->xmax   = (float) xmax;
+	s->inv_dx = (float) (((double) (n-1))/(xmax-xmin));
+	s->n      = n;
+	s->c      = (float *) malloc_aligned(nc,sizeof(float),ROUTINES_ALIGNMENT);
+	for(size_t i=0;i<nc;i++)
+		s->c[i] = (float) c[i];
+
+	free_aligned(c);
+	return s;
+}
+
+/*! \fn void uniform_spline_free(uniform_spline *s)
+ *  \brief Free a uniform spline */
+void uniform_spline_free(uniform_spline *s)
+{
+	if(!s)
+		return;
+	free_aligned(s->c);
+	free(s);
+}
+
+/*! \fn static inline double uniform_spline_eval_inline(const double *c, double xmin, double inv_dx, double last, double x)
+ *  \brief Evaluate the spline with coefficients c, and last = n-2, at x.
+ *         Shared by uniform_spline_eval and the scalar eval_many kernel. */
+ROUTINES_NO_CONTRACT
+static inline double uniform_spline_eval_inline(const double *c, double xmin, double inv_dx, double last, double x)
+{
+	double u = (x - xmin)*inv_dx;
+
+	//points outside the grid use the end intervals;
+	//a NaN x gives interval 0 and a NaN result
+	int i = (int) fmin(fmax(u,0.0),last);
+	double t = u - (double) i;
+
+	c += 4*(size_t) i;
+	return c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+}
+
+/*! \fn double uniform_spline_eval(const uniform_spline *s, double x)
+ *  \brief Evaluate a uniform spline at x */
+ROUTINES_NO_CONTRACT
+double uniform_spline_eval(const uniform_spline *s, double x)
+{
+	return uniform_spline_eval_inline(s->c,s->xmin,s->inv_dx,(double) (s->n-2),x);
+}
+
+/*! \fn void uniform_spline_free(uniform_spline_float *s)
+ *  \brief Free a float uniform spline */
+void uniform_spline_free(uniform_spline_float *s)
+{
+	if(!s)
+		return;
+	free_aligned(s->c);
+	free(s);
+}
+
+/*! \fn static inline float uniform_spline_eval_inline(const float *c, float xmin, float inv_dx, float last, float x)
+ *  \brief The float version of uniform_spline_eval_inline. */
+ROUTINES_NO_CONTRACT
+static inline float uniform_spline_eval_inline(const float *c, float xmin, float inv_dx, float last, float x)
+{
+	float u = (x - xmin)*inv_dx;
+
+	int i = (int) fminf(fmaxf(u,0.0f),last);
+	float t = u - (float) i;
+
+	c += 4*(size_t) i;
+	return c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+}
+
+/*! \fn float uniform_spline_eval(const uniform_spline_float *s, float x)
+ *  \brief Evaluate a float uniform spline at x */
+ROUTINES_NO_CONTRACT
+float uniform_spline_eval(const uniform_spline_float *s, float x)
+{
+	return uniform_spline_eval_inline(s->c,s->xmin,s->inv_dx,(float) (s->n-2),x);
+}
+
+/*! \fn uniform_spline *create_linear_uniform_spline(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads)
+ *  \brief Routine to create a uniform spline of func, interpolated linear. */
+uniform_spline *create_linear_uniform_spline(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads)
+{
+	uniform_spline *s;
+	double *x = calloc_double_array(n);
+	double *y = calloc_double_array(n);
+
+	fill_linear_grid(x,n,xmin,xmax);
+	spline_nodes_evaluate(func,x,y,n,params,false,max_threads);
+	s = uniform_spline_alloc(xmin,xmax,y,n);
+
+	free(x);
+	free(y);
+	return s;
+}
+
+/*! \fn uniform_spline *create_log10_uniform_spline(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads)
+ *  \brief Routine to make a uniform spline of func, interpolating in log10. */
+uniform_spline *create_log10_uniform_spline(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads)
+{
+	uniform_spline *s;
+	double *log10x = calloc_double_array(n);
+	double *log10y = calloc_double_array(n);
+
+	fill_linear_grid(log10x,n,log10xmin,log10xmax);
+	spline_nodes_evaluate(func,log10x,log10y,n,params,true,max_threads);
+	spline_log10_values(log10x,log10y,n);
+	s = uniform_spline_alloc(log10xmin,log10xmax,log10y,n);
+
+	free(log10x);
+	free(log10y);
+	return s;
+}
+
+/*! \fn uniform_spline_float *create_linear_uniform_spline_float(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads)
+ *  \brief Routine to create a float uniform spline of func, interpolated linear. */
+uniform_spline_float *create_linear_uniform_spline_float(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads)
+{
+	uniform_spline_float *s;
+	double *x = calloc_double_array(n);
+	double *y = calloc_double_array(n);
+
+	fill_linear_grid(x,n,xmin,xmax);
+	spline_nodes_evaluate(func,x,y,n,params,false,max_threads);
+	s = uniform_spline_float_alloc(xmin,xmax,y,n);
+
+	free(x);
+	free(y);
+	return s;
+}
+
+/*! \fn uniform_spline_float *create_log10_uniform_spline_float(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads)
+ *  \brief Routine to make a float uniform spline of func, interpolating in log10. */
+uniform_spline_float *create_log10_uniform_spline_float(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads)
+{
+	uniform_spline_float *s;
+	double *log10x = calloc_double_array(n);
+	double *log10y = calloc_double_array(n);
+
+	fill_linear_grid(log10x,n,log10xmin,log10xmax);
+	spline_nodes_evaluate(func,log10x,log10y,n,params,true,max_threads);
+	spline_log10_values(log10x,log10y,n);
+	s = uniform_spline_float_alloc(log10xmin,log10xmax,log10y,n);
+
+	free(log10x);
+	free(log10y);
+	return s;
+}
+
+/* SIMD kernels.
+
+   Each batched or reduction routine has a scalar kernel, which also
+   handles the remainder of every vector kernel, and vector kernels for
+   AVX2, AVX-512 and NEON.  On x86 the vector kernels are compiled with
+   target attributes, so they exist regardless of -march and are picked
+   at runtime from the cpu features; NEON is part of the aarch64 baseline
+   and is used whenever it is compiled in.
+
+   The batched kernels use separate multiplies and adds, not fma, and
+   evaluate in the same order as the single-vector routines.  The
+   reductions keep several independent accumulators so the loop is not
+   serialized on add or max latency; the dot product therefore sums in a
+   different order than a single running total.  The max/min reductions
+   return NaN if any element is NaN, as gsl_stats_max/min do.
+
+   The float kernels read float and, but for the float spline, widen to
+   double before they multiply or add, so a float dot product carries
+   the accuracy of the double one while moving half the bytes. */
+
+/*! \struct simd_kernels
+ *  \brief Table of the kernels chosen for this cpu. */
+struct simd_kernels
+{
+	const char *name;
+	void (*cross_2d)(double *, const double *, const double *, const double *, const double *, size_t);
+	void (*cross_3d)(double *, double *, double *, const double *, const double *, const double *, const double *, const double *, const double *, size_t);
+	void (*dot_3d)(double *, const double *, const double *, const double *, const double *, const double *, const double *, size_t);
+	void (*magnitude_3d)(double *, const double *, const double *, const double *, size_t);
+	double (*max)(const double *, size_t);
+	double (*min)(const double *, size_t);
+	void (*minmax)(const double *, size_t, double *, double *);
+	double (*dot)(const double *, const double *, size_t);
+	double (*dot_compensated)(const double *, const double *, size_t);
+	void (*det_2d)(double *, const double *, const double *, const double *, const double *, size_t);
+	void (*det_3d)(double *, const double *, const double *, const double *, const double *, const double *, const double *, const double *, const double *, const double *, size_t);
+	void (*spline)(double *, const double *, size_t, const double *, double, double, double);
+	float (*max_float)(const float *, size_t);
+	float (*min_float)(const float *, size_t);
+	void (*minmax_float)(const float *, size_t, float *, float *);
+	double (*dot_float)(const float *, const float *, size_t);
+	void (*spline_float)(float *, const float *, size_t, const float *, float, float, float);
+};
+
+ROUTINES_NO_CONTRACT
+static void cross_2d_scalar(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n)
+{
+	for(size_t i=0;i<n;i++)
+		r[i] = xx[i]*yy[i] - xy[i]*yx[i];
+}
+ROUTINES_NO_CONTRACT
+static void cross_3d_scalar(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	double cx, cy, cz;
+
+	for(size_t i=0;i<n;i++)
+	{
+		cx = xy[i]*yz[i] - xz[i]*yy[i];
+		cy = xz[i]*yx[i] - xx[i]*yz[i];
+		cz = xx[i]*yy[i] - xy[i]*yx[i];
+		rx[i] = cx;
+		ry[i] = cy;
+		rz[i] = cz;
+	}
+}
+ROUTINES_NO_CONTRACT
+static void dot_3d_scalar(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	for(size_t i=0;i<n;i++)
+		r[i] = xx[i]*yx[i] + xy[i]*yy[i] + xz[i]*yz[i];
+}
+ROUTINES_NO_CONTRACT
+static void magnitude_3d_scalar(double *r, const double *x, const double *y, const double *z, size_t n)
+{
+	for(size_t i=0;i<n;i++)
+		r[i] = sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]);
+}
+ROUTINES_NO_CONTRACT
+static void det_2d_scalar(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n)
+{
+	for(size_t i=0;i<n;i++)
+		r[i] = a00[i]*a11[i] - a01[i]*a10[i];
+}
+/* 3x3 determinants are the six-term sum of matrix_determinant, taken
+   in the same order in every kernel, including its leading 0 + which
+   turns a -0 first pair into +0. */
+ROUTINES_NO_CONTRACT
+static void det_3d_scalar(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n)
+{
+	double det;
+
+	for(size_t i=0;i<n;i++)
+	{
+		det  = 0;
+		det += a00[i]*a11[i]*a22[i] + a01[i]*a12[i]*a20[i];
+		det += a02[i]*a10[i]*a21[i] - a02[i]*a11[i]*a20[i];
+		det -= a01[i]*a10[i]*a22[i] + a00[i]*a12[i]*a21[i];
+		r[i] = det;
+	}
+}
+ROUTINES_NO_CONTRACT
+static void spline_scalar(double *y, const double *x, size_t n, const double *c, double xmin, double inv_dx, double last)
+{
+	for(size_t i=0;i<n;i++)
+		y[i] = uniform_spline_eval_inline(c,xmin,inv_dx,last,x[i]);
+}
+
+ROUTINES_NO_CONTRACT
+static void spline_float_scalar(float *y, const float *x, size_t n, const float *c, float xmin, float inv_dx, float last)
+{
+	for(size_t i=0;i<n;i++)
+		y[i] = uniform_spline_eval_inline(c,xmin,inv_dx,last,x[i]);
+}
+
+template<bool Max, typename T>
+static T extreme_scalar(const T *x, size_t n)
+{
+	T m = x[0];
+
+	for(size_t i=0;i<n;i++)
+	{
+		if(isnan(x[i]))
+			return NAN;
+		if(Max ? x[i]>m : x[i]<m)
+			m = x[i];
+	}
+	return m;
+}
+template<typename T>
+static void minmax_scalar(const T *x, size_t n, T *min, T *max)
+{
+	T lo = x[0];
+	T hi = x[0];
+
+	for(size_t i=0;i<n;i++)
+	{
+		if(isnan(x[i]))
+		{
+			*min = *max = NAN;
+			return;
+		}
+		if(x[i]<lo)
+			lo = x[i];
+		if(x[i]>hi)
+			hi = x[i];
+	}
+	*min = lo;
+	*max = hi;
+}
+ROUTINES_NO_CONTRACT
+static double dot_scalar(const double *x, const double *y, size_t n)
+{
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i  = 0;
+
+	for(;i+4<=n;i+=4)
+	{
+		s0 += x[i]  *y[i];
+		s1 += x[i+1]*y[i+1];
+		s2 += x[i+2]*y[i+2];
+		s3 += x[i+3]*y[i+3];
+	}
+	for(;i<n;i++)
+		s0 += x[i]*y[i];
+	return (s0+s1) + (s2+s3);
+}
+static double dot_float_scalar(const float *x, const float *y, size_t n)
+{
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i  = 0;
+
+	for(;i+4<=n;i+=4)
+	{
+		s0 += (double) x[i]  *y[i];
+		s1 += (double) x[i+1]*y[i+1];
+		s2 += (double) x[i+2]*y[i+2];
+		s3 += (double) x[i+3]*y[i+3];
+	}
+	for(;i<n;i++)
+		s0 += (double) x[i]*y[i];
+	return (s0+s1) + (s2+s3);
+}
+
+/* Compensated dot product (Ogita, Rump & Oishi's Dot2).  Each product is
+   split exactly into p + ep with an fma, and each running sum into s + e
+   with Knuth's branch-free TwoSum, which captures the same error as the
+   Kahan-Neumaier update.  The errors are summed separately and added at
+   the end, giving a result as accurate as if it were computed in twice
+   the working precision and then rounded. */
+ROUTINES_NO_CONTRACT
+static void dot_compensated_tail(const double *x, const double *y, size_t n, double *s, double *c)
+{
+	double p, ep, t, z;
+
+	for(size_t i=0;i<n;i++)
+	{
+		p  = x[i]*y[i];
+		ep = fma(x[i],y[i],-p);
+		t  = *s + p;
+		z  = t - *s;
+		*c += ((*s - (t - z)) + (p - z)) + ep;
+		*s  = t;
+	}
+}
+/*! \fn static double dot_compensated_finish(const double *ls, const double *lc, int w, const double *x, const double *y, size_t n)
+ *  \brief Fold w lane sums ls and corrections lc, then add the tail x*y. */
+ROUTINES_NO_CONTRACT
+static double dot_compensated_finish(const double *ls, const double *lc, int w, const double *x, const double *y, size_t n)
+{
+	double s = 0, c = 0, t, z;
+
+	for(int k=0;k<w;k++)
+	{
+		t  = s + ls[k];
+		z  = t - s;
+		c += ((s - (t - z)) + (ls[k] - z)) + lc[k];
+		s  = t;
+	}
+	dot_compensated_tail(x,y,n,&s,&c);
+	return s + c;
+}
+static double dot_compensated_scalar(const double *x, const double *y, size_t n)
+{
+	return dot_compensated_finish(NULL,NULL,0,x,y,n);
+}
+
+#ifdef ROUTINES_X86_SIMD
+/* The scalar tails are compiled for the baseline ISA, so the upper halves
+   of the vector registers are cleared before calling them.  GCC does not
+   do this across a call from a target("avx...") function, and running SSE
+   code with dirty upper state costs hundreds of cycles per call. */
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void cross_2d_avx2(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n)
+{
+	size_t i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		__m256d a = _mm256_mul_pd(_mm256_loadu_pd(xx+i),_mm256_loadu_pd(yy+i));
+		__m256d b = _mm256_mul_pd(_mm256_loadu_pd(xy+i),_mm256_loadu_pd(yx+i));
+		_mm256_storeu_pd(r+i,_mm256_sub_pd(a,b));
+	}
+	_mm256_zeroupper();
+	cross_2d_scalar(r+i,xx+i,xy+i,yx+i,yy+i,n-i);
+}
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void cross_3d_avx2(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	size_t i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		__m256d ax = _mm256_loadu_pd(xx+i), ay = _mm256_loadu_pd(xy+i), az = _mm256_loadu_pd(xz+i);
+		__m256d bx = _mm256_loadu_pd(yx+i), by = _mm256_loadu_pd(yy+i), bz = _mm256_loadu_pd(yz+i);
+		_mm256_storeu_pd(rx+i,_mm256_sub_pd(_mm256_mul_pd(ay,bz),_mm256_mul_pd(az,by)));
+		_mm256_storeu_pd(ry+i,_mm256_sub_pd(_mm256_mul_pd(az,bx),_mm256_mul_pd(ax,bz)));
+		_mm256_storeu_pd(rz+i,_mm256_sub_pd(_mm256_mul_pd(ax,by),_mm256_mul_pd(ay,bx)));
+	}
+	_mm256_zeroupper();
+	cross_3d_scalar(rx+i,ry+i,rz+i,xx+i,xy+i,xz+i,yx+i,yy+i,yz+i,n-i);
+}
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void dot_3d_avx2(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	size_t i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		__m256d d = _mm256_mul_pd(_mm256_loadu_pd(xx+i),_mm256_loadu_pd(yx+i));
+		d = _mm256_add_pd(d,_mm256_mul_pd(_mm256_loadu_pd(xy+i),_mm256_loadu_pd(yy+i)));
+		d = _mm256_add_pd(d,_mm256_mul_pd(_mm256_loadu_pd(xz+i),_mm256_loadu_pd(yz+i)));
+		_mm256_storeu_pd(r+i,d);
+	}
+	_mm256_zeroupper();
+	dot_3d_scalar(r+i,xx+i,xy+i,xz+i,yx+i,yy+i,yz+i,n-i);
+}
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void magnitude_3d_avx2(double *r, const double *x, const double *y, const double *z, size_t n)
+{
+	size_t i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		__m256d a = _mm256_loadu_pd(x+i), b = _mm256_loadu_pd(y+i), c = _mm256_loadu_pd(z+i);
+		__m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a,a),_mm256_mul_pd(b,b)),_mm256_mul_pd(c,c));
+		_mm256_storeu_pd(r+i,_mm256_sqrt_pd(d));
+	}
+	_mm256_zeroupper();
+	magnitude_3d_scalar(r+i,x+i,y+i,z+i,n-i);
+}
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void det_2d_avx2(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n)
+{
+	size_t i = 0;
+	for(;i+4<=n;i+=4)
+		_mm256_storeu_pd(r+i,_mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(a00+i),_mm256_loadu_pd(a11+i)),_mm256_mul_pd(_mm256_loadu_pd(a01+i),_mm256_loadu_pd(a10+i))));
+	_mm256_zeroupper();
+	det_2d_scalar(r+i,a00+i,a01+i,a10+i,a11+i,n-i);
+}
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void det_3d_avx2(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n)
+{
+	size_t i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		__m256d b00 = _mm256_loadu_pd(a00+i), b01 = _mm256_loadu_pd(a01+i), b02 = _mm256_loadu_pd(a02+i);
+		__m256d b10 = _mm256_loadu_pd(a10+i), b11 = _mm256_loadu_pd(a11+i), b12 = _mm256_loadu_pd(a12+i);
+		__m256d b20 = _mm256_loadu_pd(a20+i), b21 = _mm256_loadu_pd(a21+i), b22 = _mm256_loadu_pd(a22+i);
+		__m256d d   = _mm256_add_pd(_mm256_setzero_pd(),_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(b00,b11),b22),_mm256_mul_pd(_mm256_mul_pd(b01,b12),b20)));
+		d = _mm256_add_pd(d,_mm256_sub_pd(_mm256_mul_pd(_mm256_mul_pd(b02,b10),b21),_mm256_mul_pd(_mm256_mul_pd(b02,b11),b20)));
+		d = _mm256_sub_pd(d,_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(b01,b10),b22),_mm256_mul_pd(_mm256_mul_pd(b00,b12),b21)));
+		_mm256_storeu_pd(r+i,d);
+	}
+	_mm256_zeroupper();
+	det_3d_scalar(r+i,a00+i,a01+i,a02+i,a10+i,a11+i,a12+i,a20+i,a21+i,a22+i,n-i);
+}
+/* The uniform spline kernels gather the four coefficients of each
+   lane's interval; the clamping max/min return the second operand for a
+   NaN, as fmax/fmin do in the scalar kernel.  The gathers take 32-bit
+   offsets 4k, so splines with more intervals than
+   ROUTINES_SPLINE_GATHER_MAX are left to the scalar kernels. */
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void spline_avx2(double *y, const double *x, size_t n, const double *c, double xmin, double inv_dx, double last)
+{
+	const __m256d lo = _mm256_set1_pd(xmin), sc = _mm256_set1_pd(inv_dx);
+	const __m256d zero = _mm256_setzero_pd(), hi = _mm256_set1_pd(last);
+	size_t i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		__m256d u   = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(x+i),lo),sc);
+		__m128i k   = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(u,zero),hi));
+		__m256d t   = _mm256_sub_pd(u,_mm256_cvtepi32_pd(k));
+		__m128i idx = _mm_slli_epi32(k,2);
+		__m256d p   = _mm256_i32gather_pd(c+3,idx,8);
+		p = _mm256_add_pd(_mm256_i32gather_pd(c+2,idx,8),_mm256_mul_pd(t,p));
+		p = _mm256_add_pd(_mm256_i32gather_pd(c+1,idx,8),_mm256_mul_pd(t,p));
+		p = _mm256_add_pd(_mm256_i32gather_pd(c,  idx,8),_mm256_mul_pd(t,p));
+		_mm256_storeu_pd(y+i,p);
+	}
+	_mm256_zeroupper();
+	spline_scalar(y+i,x+i,n-i,c,xmin,inv_dx,last);
+}
+
+/* If any lane of a max/min accumulator has seen a NaN the comparison
+   instructions would drop it, so NaNs are tracked in a separate mask. */
+template<bool Max>
+__attribute__((target("avx2")))
+static double extreme_avx2(const double *x, size_t n)
+{
+	double  lane[4];
+	double  m;
+	size_t  i = 8;
+
+	if(n<8)
+		return extreme_scalar<Max>(x,n);
+
+	__m256d m0  = _mm256_loadu_pd(x), m1 = _mm256_loadu_pd(x+4);
+	__m256d nan = _mm256_cmp_pd(m0,m1,_CMP_UNORD_Q);
+	for(;i+8<=n;i+=8)
+	{
+		__m256d a = _mm256_loadu_pd(x+i), b = _mm256_loadu_pd(x+i+4);
+		nan = _mm256_or_pd(nan,_mm256_cmp_pd(a,b,_CMP_UNORD_Q));
+		m0  = Max ? _mm256_max_pd(m0,a) : _mm256_min_pd(m0,a);
+		m1  = Max ? _mm256_max_pd(m1,b) : _mm256_min_pd(m1,b);
+	}
+	if(_mm256_movemask_pd(nan))
+		return NAN;
+	_mm256_storeu_pd(lane,Max ? _mm256_max_pd(m0,m1) : _mm256_min_pd(m0,m1));
+	_mm256_zeroupper();
+	m = extreme_scalar<Max>(lane,4);
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		double t = extreme_scalar<Max>(x+i,n-i);
+		m = (isnan(t) || (Max ? t>m : t<m)) ? t : m;
+	}
+	return m;
+}
+__attribute__((target("avx2")))
+static void minmax_avx2(const double *x, size_t n, double *min, double *max)
+{
+	double  lo[4], hi[4];
+	double  tlo, thi;
+	size_t  i = 4;
+
+	if(n<4)
+	{
+		minmax_scalar(x,n,min,max);
+		return;
+	}
+
+	__m256d l   = _mm256_loadu_pd(x), h = l;
+	__m256d nan = _mm256_cmp_pd(l,l,_CMP_UNORD_Q);
+	for(;i+8<=n;i+=8)
+	{
+		__m256d a = _mm256_loadu_pd(x+i), b = _mm256_loadu_pd(x+i+4);
+		nan = _mm256_or_pd(nan,_mm256_cmp_pd(a,b,_CMP_UNORD_Q));
+		l   = _mm256_min_pd(l,_mm256_min_pd(a,b));
+		h   = _mm256_max_pd(h,_mm256_max_pd(a,b));
+	}
+	if(_mm256_movemask_pd(nan))
+	{
+		*min = *max = NAN;
+		return;
+	}
+	_mm256_storeu_pd(lo,l);
+	_mm256_storeu_pd(hi,h);
+	_mm256_zeroupper();
+	*min = extreme_scalar<false>(lo,4);
+	*max = extreme_scalar<true>(hi,4);
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		minmax_scalar(x+i,n-i,&tlo,&thi);
+		if(isnan(tlo))
+		{
+			*min = *max = NAN;
+			return;
+		}
+		*min = GSL_MIN_DBL(*min,tlo);
+		*max = GSL_MAX_DBL(*max,thi);
+	}
+}
+__attribute__((target("avx2,fma"))) ROUTINES_NO_CONTRACT
+static double dot_avx2(const double *x, const double *y, size_t n)
+{
+	double  lane[4];
+	size_t  i = 0;
+
+	__m256d s0 = _mm256_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+	for(;i+16<=n;i+=16)
+	{
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i),   _mm256_loadu_pd(y+i),   s0);
+		s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+4), _mm256_loadu_pd(y+i+4), s1);
+		s2 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+8), _mm256_loadu_pd(y+i+8), s2);
+		s3 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+12),_mm256_loadu_pd(y+i+12),s3);
+	}
+	for(;i+4<=n;i+=4)
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i),s0);
+	_mm256_storeu_pd(lane,_mm256_add_pd(_mm256_add_pd(s0,s1),_mm256_add_pd(s2,s3)));
+	_mm256_zeroupper();
+	return ((lane[0]+lane[1]) + (lane[2]+lane[3])) + dot_scalar(x+i,y+i,n-i);
+}
+
+__attribute__((target("avx2,fma"))) ROUTINES_NO_CONTRACT
+static double dot_compensated_avx2(const double *x, const double *y, size_t n)
+{
+	double  ls[8], lc[8];
+	size_t  i = 0;
+
+	//two independent accumulators hide the TwoSum latency chain
+	__m256d s0 = _mm256_setzero_pd(), s1 = s0, c0 = s0, c1 = s0;
+	for(;i+8<=n;i+=8)
+	{
+		__m256d a0 = _mm256_loadu_pd(x+i),   b0 = _mm256_loadu_pd(y+i);
+		__m256d a1 = _mm256_loadu_pd(x+i+4), b1 = _mm256_loadu_pd(y+i+4);
+		__m256d p0 = _mm256_mul_pd(a0,b0),   p1 = _mm256_mul_pd(a1,b1);
+		__m256d t0 = _mm256_add_pd(s0,p0),   t1 = _mm256_add_pd(s1,p1);
+		__m256d z0 = _mm256_sub_pd(t0,s0),   z1 = _mm256_sub_pd(t1,s1);
+		__m256d e0 = _mm256_add_pd(_mm256_sub_pd(s0,_mm256_sub_pd(t0,z0)),_mm256_sub_pd(p0,z0));
+		__m256d e1 = _mm256_add_pd(_mm256_sub_pd(s1,_mm256_sub_pd(t1,z1)),_mm256_sub_pd(p1,z1));
+		c0 = _mm256_add_pd(c0,_mm256_add_pd(e0,_mm256_fmsub_pd(a0,b0,p0)));
+		c1 = _mm256_add_pd(c1,_mm256_add_pd(e1,_mm256_fmsub_pd(a1,b1,p1)));
+		s0 = t0;
+		s1 = t1;
+	}
+	_mm256_storeu_pd(ls,s0);
+	_mm256_storeu_pd(ls+4,s1);
+	_mm256_storeu_pd(lc,c0);
+	_mm256_storeu_pd(lc+4,c1);
+	_mm256_zeroupper();
+	return dot_compensated_finish(ls,lc,8,x+i,y+i,n-i);
+}
+
+__attribute__((target("avx2"))) ROUTINES_NO_CONTRACT
+static void spline_float_avx2(float *y, const float *x, size_t n, const float *c, float xmin, float inv_dx, float last)
+{
+	const __m256 lo = _mm256_set1_ps(xmin), sc = _mm256_set1_ps(inv_dx);
+	const __m256 zero = _mm256_setzero_ps(), hi = _mm256_set1_ps(last);
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m256  u   = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x+i),lo),sc);
+		__m256i k   = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(u,zero),hi));
+		__m256  t   = _mm256_sub_ps(u,_mm256_cvtepi32_ps(k));
+		__m256i idx = _mm256_slli_epi32(k,2);
+		__m256  p   = _mm256_i32gather_ps(c+3,idx,4);
+		p = _mm256_add_ps(_mm256_i32gather_ps(c+2,idx,4),_mm256_mul_ps(t,p));
+		p = _mm256_add_ps(_mm256_i32gather_ps(c+1,idx,4),_mm256_mul_ps(t,p));
+		p = _mm256_add_ps(_mm256_i32gather_ps(c,  idx,4),_mm256_mul_ps(t,p));
+		_mm256_storeu_ps(y+i,p);
+	}
+	_mm256_zeroupper();
+	spline_float_scalar(y+i,x+i,n-i,c,xmin,inv_dx,last);
+}
+template<bool Max>
+__attribute__((target("avx2")))
+static float extreme_float_avx2(const float *x, size_t n)
+{
+	float   lane[8];
+	float   m;
+	size_t  i = 16;
+
+	if(n<16)
+		return extreme_scalar<Max>(x,n);
+
+	__m256  m0  = _mm256_loadu_ps(x), m1 = _mm256_loadu_ps(x+8);
+	__m256  nan = _mm256_cmp_ps(m0,m1,_CMP_UNORD_Q);
+	for(;i+16<=n;i+=16)
+	{
+		__m256 a = _mm256_loadu_ps(x+i), b = _mm256_loadu_ps(x+i+8);
+		nan = _mm256_or_ps(nan,_mm256_cmp_ps(a,b,_CMP_UNORD_Q));
+		m0  = Max ? _mm256_max_ps(m0,a) : _mm256_min_ps(m0,a);
+		m1  = Max ? _mm256_max_ps(m1,b) : _mm256_min_ps(m1,b);
+	}
+	if(_mm256_movemask_ps(nan))
+		return NAN;
+	_mm256_storeu_ps(lane,Max ? _mm256_max_ps(m0,m1) : _mm256_min_ps(m0,m1));
+	_mm256_zeroupper();
+	m = extreme_scalar<Max>(lane,8);
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		float t = extreme_scalar<Max>(x+i,n-i);
+		m = (isnan(t) || (Max ? t>m : t<m)) ? t : m;
+	}
+	return m;
+}
+__attribute__((target("avx2")))
+static void minmax_float_avx2(const float *x, size_t n, float *min, float *max)
+{
+	float   lo[8], hi[8];
+	float   tlo, thi;
+	size_t  i = 8;
+
+	if(n<8)
+	{
+		minmax_scalar(x,n,min,max);
+		return;
+	}
+
+	__m256  l   = _mm256_loadu_ps(x), h = l;
+	__m256  nan = _mm256_cmp_ps(l,l,_CMP_UNORD_Q);
+	for(;i+16<=n;i+=16)
+	{
+		__m256 a = _mm256_loadu_ps(x+i), b = _mm256_loadu_ps(x+i+8);
+		nan = _mm256_or_ps(nan,_mm256_cmp_ps(a,b,_CMP_UNORD_Q));
+		l   = _mm256_min_ps(l,_mm256_min_ps(a,b));
+		h   = _mm256_max_ps(h,_mm256_max_ps(a,b));
+	}
+	if(_mm256_movemask_ps(nan))
+	{
+		*min = *max = NAN;
+		return;
+	}
+	_mm256_storeu_ps(lo,l);
+	_mm256_storeu_ps(hi,h);
+	_mm256_zeroupper();
+	*min = extreme_scalar<false>(lo,8);
+	*max = extreme_scalar<true>(hi,8);
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		minmax_scalar(x+i,n-i,&tlo,&thi);
+		if(isnan(tlo))
+		{
+			*min = *max = NAN;
+			return;
+		}
+		*min = fminf(*min,tlo);
+		*max = fmaxf(*max,thi);
+	}
+}
+__attribute__((target("avx2,fma")))
+static double dot_float_avx2(const float *x, const float *y, size_t n)
+{
+	double  lane[4];
+	size_t  i = 0;
+
+	__m256d s0 = _mm256_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+	for(;i+16<=n;i+=16)
+	{
+		s0 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i)),   _mm256_cvtps_pd(_mm_loadu_ps(y+i)),   s0);
+		s1 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i+4)), _mm256_cvtps_pd(_mm_loadu_ps(y+i+4)), s1);
+		s2 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i+8)), _mm256_cvtps_pd(_mm_loadu_ps(y+i+8)), s2);
+		s3 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i+12)),_mm256_cvtps_pd(_mm_loadu_ps(y+i+12)),s3);
+	}
+	for(;i+4<=n;i+=4)
+		s0 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i)),_mm256_cvtps_pd(_mm_loadu_ps(y+i)),s0);
+	_mm256_storeu_pd(lane,_mm256_add_pd(_mm256_add_pd(s0,s1),_mm256_add_pd(s2,s3)));
+	_mm256_zeroupper();
+	return ((lane[0]+lane[1]) + (lane[2]+lane[3])) + dot_float_scalar(x+i,y+i,n-i);
+}
+
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void cross_2d_avx512(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n)
+{
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m512d a = _mm512_mul_pd(_mm512_loadu_pd(xx+i),_mm512_loadu_pd(yy+i));
+		__m512d b = _mm512_mul_pd(_mm512_loadu_pd(xy+i),_mm512_loadu_pd(yx+i));
+		_mm512_storeu_pd(r+i,_mm512_sub_pd(a,b));
+	}
+	_mm256_zeroupper();
+	cross_2d_scalar(r+i,xx+i,xy+i,yx+i,yy+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void cross_3d_avx512(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m512d ax = _mm512_loadu_pd(xx+i), ay = _mm512_loadu_pd(xy+i), az = _mm512_loadu_pd(xz+i);
+		__m512d bx = _mm512_loadu_pd(yx+i), by = _mm512_loadu_pd(yy+i), bz = _mm512_loadu_pd(yz+i);
+		_mm512_storeu_pd(rx+i,_mm512_sub_pd(_mm512_mul_pd(ay,bz),_mm512_mul_pd(az,by)));
+		_mm512_storeu_pd(ry+i,_mm512_sub_pd(_mm512_mul_pd(az,bx),_mm512_mul_pd(ax,bz)));
+		_mm512_storeu_pd(rz+i,_mm512_sub_pd(_mm512_mul_pd(ax,by),_mm512_mul_pd(ay,bx)));
+	}
+	_mm256_zeroupper();
+	cross_3d_scalar(rx+i,ry+i,rz+i,xx+i,xy+i,xz+i,yx+i,yy+i,yz+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void dot_3d_avx512(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m512d d = _mm512_mul_pd(_mm512_loadu_pd(xx+i),_mm512_loadu_pd(yx+i));
+		d = _mm512_add_pd(d,_mm512_mul_pd(_mm512_loadu_pd(xy+i),_mm512_loadu_pd(yy+i)));
+		d = _mm512_add_pd(d,_mm512_mul_pd(_mm512_loadu_pd(xz+i),_mm512_loadu_pd(yz+i)));
+		_mm512_storeu_pd(r+i,d);
+	}
+	_mm256_zeroupper();
+	dot_3d_scalar(r+i,xx+i,xy+i,xz+i,yx+i,yy+i,yz+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void magnitude_3d_avx512(double *r, const double *x, const double *y, const double *z, size_t n)
+{
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m512d a = _mm512_loadu_pd(x+i), b = _mm512_loadu_pd(y+i), c = _mm512_loadu_pd(z+i);
+		__m512d d = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(a,a),_mm512_mul_pd(b,b)),_mm512_mul_pd(c,c));
+		_mm512_storeu_pd(r+i,_mm512_sqrt_pd(d));
+	}
+	_mm256_zeroupper();
+	magnitude_3d_scalar(r+i,x+i,y+i,z+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void det_2d_avx512(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n)
+{
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+		_mm512_storeu_pd(r+i,_mm512_sub_pd(_mm512_mul_pd(_mm512_loadu_pd(a00+i),_mm512_loadu_pd(a11+i)),_mm512_mul_pd(_mm512_loadu_pd(a01+i),_mm512_loadu_pd(a10+i))));
+	_mm256_zeroupper();
+	det_2d_scalar(r+i,a00+i,a01+i,a10+i,a11+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void det_3d_avx512(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n)
+{
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m512d b00 = _mm512_loadu_pd(a00+i), b01 = _mm512_loadu_pd(a01+i), b02 = _mm512_loadu_pd(a02+i);
+		__m512d b10 = _mm512_loadu_pd(a10+i), b11 = _mm512_loadu_pd(a11+i), b12 = _mm512_loadu_pd(a12+i);
+		__m512d b20 = _mm512_loadu_pd(a20+i), b21 = _mm512_loadu_pd(a21+i), b22 = _mm512_loadu_pd(a22+i);
+		__m512d d   = _mm512_add_pd(_mm512_setzero_pd(),_mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(b00,b11),b22),_mm512_mul_pd(_mm512_mul_pd(b01,b12),b20)));
+		d = _mm512_add_pd(d,_mm512_sub_pd(_mm512_mul_pd(_mm512_mul_pd(b02,b10),b21),_mm512_mul_pd(_mm512_mul_pd(b02,b11),b20)));
+		d = _mm512_sub_pd(d,_mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(b01,b10),b22),_mm512_mul_pd(_mm512_mul_pd(b00,b12),b21)));
+		_mm512_storeu_pd(r+i,d);
+	}
+	_mm256_zeroupper();
+	det_3d_scalar(r+i,a00+i,a01+i,a02+i,a10+i,a11+i,a12+i,a20+i,a21+i,a22+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void spline_avx512(double *y, const double *x, size_t n, const double *c, double xmin, double inv_dx, double last)
+{
+	const __m512d lo = _mm512_set1_pd(xmin), sc = _mm512_set1_pd(inv_dx);
+	const __m512d zero = _mm512_setzero_pd(), hi = _mm512_set1_pd(last);
+	size_t i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m512d u   = _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(x+i),lo),sc);
+		__m256i k   = _mm512_cvttpd_epi32(_mm512_min_pd(_mm512_max_pd(u,zero),hi));
+		__m512d t   = _mm512_sub_pd(u,_mm512_cvtepi32_pd(k));
+		__m256i idx = _mm256_slli_epi32(k,2);
+		__m512d p   = _mm512_i32gather_pd(idx,c+3,8);
+		p = _mm512_add_pd(_mm512_i32gather_pd(idx,c+2,8),_mm512_mul_pd(t,p));
+		p = _mm512_add_pd(_mm512_i32gather_pd(idx,c+1,8),_mm512_mul_pd(t,p));
+		p = _mm512_add_pd(_mm512_i32gather_pd(idx,c,  8),_mm512_mul_pd(t,p));
+		_mm512_storeu_pd(y+i,p);
+	}
+	_mm256_zeroupper();
+	spline_scalar(y+i,x+i,n-i,c,xmin,inv_dx,last);
+}
+
+template<bool Max>
+__attribute__((target("avx512f")))
+static double extreme_avx512(const double *x, size_t n)
+{
+	double    m;
+	size_t    i = 16;
+
+	if(n<16)
+		return extreme_scalar<Max>(x,n);
+
+	__m512d   m0  = _mm512_loadu_pd(x), m1 = _mm512_loadu_pd(x+8);
+	__mmask8  nan = _mm512_cmp_pd_mask(m0,m1,_CMP_UNORD_Q);
+	for(;i+16<=n;i+=16)
+	{
+		__m512d a = _mm512_loadu_pd(x+i), b = _mm512_loadu_pd(x+i+8);
+		nan = nan | _mm512_cmp_pd_mask(a,b,_CMP_UNORD_Q);
+		m0  = Max ? _mm512_max_pd(m0,a) : _mm512_min_pd(m0,a);
+		m1  = Max ? _mm512_max_pd(m1,b) : _mm512_min_pd(m1,b);
+	}
+	if(nan)
+		return NAN;
+	m = Max ? _mm512_reduce_max_pd(_mm512_max_pd(m0,m1)) : _mm512_reduce_min_pd(_mm512_min_pd(m0,m1));
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		double t = extreme_scalar<Max>(x+i,n-i);
+		m = (isnan(t) || (Max ? t>m : t<m)) ? t : m;
+	}
+	return m;
+}
+__attribute__((target("avx512f")))
+static void minmax_avx512(const double *x, size_t n, double *min, double *max)
+{
+	double    tlo, thi;
+	size_t    i = 8;
+
+	if(n<8)
+	{
+		minmax_scalar(x,n,min,max);
+		return;
+	}
+
+	__m512d   l   = _mm512_loadu_pd(x), h = l;
+	__mmask8  nan = _mm512_cmp_pd_mask(l,l,_CMP_UNORD_Q);
+	for(;i+16<=n;i+=16)
+	{
+		__m512d a = _mm512_loadu_pd(x+i), b = _mm512_loadu_pd(x+i+8);
+		nan = nan | _mm512_cmp_pd_mask(a,b,_CMP_UNORD_Q);
+		l   = _mm512_min_pd(l,_mm512_min_pd(a,b));
+		h   = _mm512_max_pd(h,_mm512_max_pd(a,b));
+	}
+	if(nan)
+	{
+		*min = *max = NAN;
+		return;
+	}
+	*min = _mm512_reduce_min_pd(l);
+	*max = _mm512_reduce_max_pd(h);
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		minmax_scalar(x+i,n-i,&tlo,&thi);
+		if(isnan(tlo))
+		{
+			*min = *max = NAN;
+			return;
+		}
+		*min = GSL_MIN_DBL(*min,tlo);
+		*max = GSL_MAX_DBL(*max,thi);
+	}
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static double dot_avx512(const double *x, const double *y, size_t n)
+{
+	size_t  i = 0;
+
+	__m512d s0 = _mm512_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+	for(;i+32<=n;i+=32)
+	{
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i),   _mm512_loadu_pd(y+i),   s0);
+		s1 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i+8), _mm512_loadu_pd(y+i+8), s1);
+		s2 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i+16),_mm512_loadu_pd(y+i+16),s2);
+		s3 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i+24),_mm512_loadu_pd(y+i+24),s3);
+	}
+	for(;i+8<=n;i+=8)
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i),_mm512_loadu_pd(y+i),s0);
+	double s = _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(s0,s1),_mm512_add_pd(s2,s3)));
+	_mm256_zeroupper();
+	return s + dot_scalar(x+i,y+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static double dot_compensated_avx512(const double *x, const double *y, size_t n)
+{
+	double  ls[16], lc[16];
+	size_t  i = 0;
+
+	__m512d s0 = _mm512_setzero_pd(), s1 = s0, c0 = s0, c1 = s0;
+	for(;i+16<=n;i+=16)
+	{
+		__m512d a0 = _mm512_loadu_pd(x+i),   b0 = _mm512_loadu_pd(y+i);
+		__m512d a1 = _mm512_loadu_pd(x+i+8), b1 = _mm512_loadu_pd(y+i+8);
+		__m512d p0 = _mm512_mul_pd(a0,b0),   p1 = _mm512_mul_pd(a1,b1);
+		__m512d t0 = _mm512_add_pd(s0,p0),   t1 = _mm512_add_pd(s1,p1);
+		__m512d z0 = _mm512_sub_pd(t0,s0),   z1 = _mm512_sub_pd(t1,s1);
+		__m512d e0 = _mm512_add_pd(_mm512_sub_pd(s0,_mm512_sub_pd(t0,z0)),_mm512_sub_pd(p0,z0));
+		__m512d e1 = _mm512_add_pd(_mm512_sub_pd(s1,_mm512_sub_pd(t1,z1)),_mm512_sub_pd(p1,z1));
+		c0 = _mm512_add_pd(c0,_mm512_add_pd(e0,_mm512_fmsub_pd(a0,b0,p0)));
+		c1 = _mm512_add_pd(c1,_mm512_add_pd(e1,_mm512_fmsub_pd(a1,b1,p1)));
+		s0 = t0;
+		s1 = t1;
+	}
+	_mm512_storeu_pd(ls,s0);
+	_mm512_storeu_pd(ls+8,s1);
+	_mm512_storeu_pd(lc,c0);
+	_mm512_storeu_pd(lc+8,c1);
+	_mm256_zeroupper();
+	return dot_compensated_finish(ls,lc,16,x+i,y+i,n-i);
+}
+__attribute__((target("avx512f"))) ROUTINES_NO_CONTRACT
+static void spline_float_avx512(float *y, const float *x, size_t n, const float *c, float xmin, float inv_dx, float last)
+{
+	const __m512 lo = _mm512_set1_ps(xmin), sc = _mm512_set1_ps(inv_dx);
+	const __m512 zero = _mm512_setzero_ps(), hi = _mm512_set1_ps(last);
+	size_t i = 0;
+	for(;i+16<=n;i+=16)
+	{
+		__m512  u   = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(x+i),lo),sc);
+		__m512i k   = _mm512_cvttps_epi32(_mm512_min_ps(_mm512_max_ps(u,zero),hi));
+		__m512  t   = _mm512_sub_ps(u,_mm512_cvtepi32_ps(k));
+		__m512i idx = _mm512_slli_epi32(k,2);
+		__m512  p   = _mm512_i32gather_ps(idx,c+3,4);
+		p = _mm512_add_ps(_mm512_i32gather_ps(idx,c+2,4),_mm512_mul_ps(t,p));
+		p = _mm512_add_ps(_mm512_i32gather_ps(idx,c+1,4),_mm512_mul_ps(t,p));
+		p = _mm512_add_ps(_mm512_i32gather_ps(idx,c,  4),_mm512_mul_ps(t,p));
+		_mm512_storeu_ps(y+i,p);
+	}
+	_mm256_zeroupper();
+	spline_float_scalar(y+i,x+i,n-i,c,xmin,inv_dx,last);
+}
+template<bool Max>
+__attribute__((target("avx512f")))
+static float extreme_float_avx512(const float *x, size_t n)
+{
+	float     m;
+	size_t    i = 32;
+
+	if(n<32)
+		return extreme_scalar<Max>(x,n);
+
+	__m512    m0  = _mm512_loadu_ps(x), m1 = _mm512_loadu_ps(x+16);
+	__mmask16 nan = _mm512_cmp_ps_mask(m0,m1,_CMP_UNORD_Q);
+	for(;i+32<=n;i+=32)
+	{
+		__m512 a = _mm512_loadu_ps(x+i), b = _mm512_loadu_ps(x+i+16);
+		nan = nan | _mm512_cmp_ps_mask(a,b,_CMP_UNORD_Q);
+		m0  = Max ? _mm512_max_ps(m0,a) : _mm512_min_ps(m0,a);
+		m1  = Max ? _mm512_max_ps(m1,b) : _mm512_min_ps(m1,b);
+	}
+	if(nan)
+		return NAN;
+	m = Max ? _mm512_reduce_max_ps(_mm512_max_ps(m0,m1)) : _mm512_reduce_min_ps(_mm512_min_ps(m0,m1));
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		float t = extreme_scalar<Max>(x+i,n-i);
+		m = (isnan(t) || (Max ? t>m : t<m)) ? t : m;
+	}
+	return m;
+}
+__attribute__((target("avx512f")))
+static void minmax_float_avx512(const float *x, size_t n, float *min, float *max)
+{
+	float     tlo, thi;
+	size_t    i = 16;
+
+	if(n<16)
+	{
+		minmax_scalar(x,n,min,max);
+		return;
+	}
+
+	__m512    l   = _mm512_loadu_ps(x), h = l;
+	__mmask16 nan = _mm512_cmp_ps_mask(l,l,_CMP_UNORD_Q);
+	for(;i+32<=n;i+=32)
+	{
+		__m512 a = _mm512_loadu_ps(x+i), b = _mm512_loadu_ps(x+i+16);
+		nan = nan | _mm512_cmp_ps_mask(a,b,_CMP_UNORD_Q);
+		l   = _mm512_min_ps(l,_mm512_min_ps(a,b));
+		h   = _mm512_max_ps(h,_mm512_max_ps(a,b));
+	}
+	if(nan)
+	{
+		*min = *max = NAN;
+		return;
+	}
+	*min = _mm512_reduce_min_ps(l);
+	*max = _mm512_reduce_max_ps(h);
+	if(i<n)
+	{
+		_mm256_zeroupper();
+		minmax_scalar(x+i,n-i,&tlo,&thi);
+		if(isnan(tlo))
+		{
+			*min = *max = NAN;
+			return;
+		}
+		*min = fminf(*min,tlo);
+		*max = fmaxf(*max,thi);
+	}
+}
+__attribute__((target("avx512f")))
+static double dot_float_avx512(const float *x, const float *y, size_t n)
+{
+	size_t  i = 0;
+
+	__m512d s0 = _mm512_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+	for(;i+32<=n;i+=32)
+	{
+		s0 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x+i)),   _mm512_cvtps_pd(_mm256_loadu_ps(y+i)),   s0);
+		s1 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x+i+8)), _mm512_cvtps_pd(_mm256_loadu_ps(y+i+8)), s1);
+		s2 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x+i+16)),_mm512_cvtps_pd(_mm256_loadu_ps(y+i+16)),s2);
+		s3 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x+i+24)),_mm512_cvtps_pd(_mm256_loadu_ps(y+i+24)),s3);
+	}
+	for(;i+8<=n;i+=8)
+		s0 = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x+i)),_mm512_cvtps_pd(_mm256_loadu_ps(y+i)),s0);
+	double s = _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(s0,s1),_mm512_add_pd(s2,s3)));
+	_mm256_zeroupper();
+	return s + dot_float_scalar(x+i,y+i,n-i);
+}
+#endif //ROUTINES_X86_SIMD
+
+#ifdef ROUTINES_NEON_SIMD
+ROUTINES_NO_CONTRACT
+static void cross_2d_neon(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n)
+{
+	size_t i = 0;
+	for(;i+2<=n;i+=2)
+		vst1q_f64(r+i,vsubq_f64(vmulq_f64(vld1q_f64(xx+i),vld1q_f64(yy+i)),vmulq_f64(vld1q_f64(xy+i),vld1q_f64(yx+i))));
+	cross_2d_scalar(r+i,xx+i,xy+i,yx+i,yy+i,n-i);
+}
+ROUTINES_NO_CONTRACT
+static void cross_3d_neon(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	size_t i = 0;
+	for(;i+2<=n;i+=2)
+	{
+		float64x2_t ax = vld1q_f64(xx+i), ay = vld1q_f64(xy+i), az = vld1q_f64(xz+i);
+		float64x2_t bx = vld1q_f64(yx+i), by = vld1q_f64(yy+i), bz = vld1q_f64(yz+i);
+		vst1q_f64(rx+i,vsubq_f64(vmulq_f64(ay,bz),vmulq_f64(az,by)));
+		vst1q_f64(ry+i,vsubq_f64(vmulq_f64(az,bx),vmulq_f64(ax,bz)));
+		vst1q_f64(rz+i,vsubq_f64(vmulq_f64(ax,by),vmulq_f64(ay,bx)));
+	}
+	cross_3d_scalar(rx+i,ry+i,rz+i,xx+i,xy+i,xz+i,yx+i,yy+i,yz+i,n-i);
+}
+ROUTINES_NO_CONTRACT
+static void dot_3d_neon(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	size_t i = 0;
+	for(;i+2<=n;i+=2)
+	{
+		float64x2_t d = vmulq_f64(vld1q_f64(xx+i),vld1q_f64(yx+i));
+		d = vaddq_f64(d,vmulq_f64(vld1q_f64(xy+i),vld1q_f64(yy+i)));
+		d = vaddq_f64(d,vmulq_f64(vld1q_f64(xz+i),vld1q_f64(yz+i)));
+		vst1q_f64(r+i,d);
+	}
+	dot_3d_scalar(r+i,xx+i,xy+i,xz+i,yx+i,yy+i,yz+i,n-i);
+}
+ROUTINES_NO_CONTRACT
+static void magnitude_3d_neon(double *r, const double *x, const double *y, const double *z, size_t n)
+{
+	size_t i = 0;
+	for(;i+2<=n;i+=2)
+	{
+		float64x2_t a = vld1q_f64(x+i), b = vld1q_f64(y+i), c = vld1q_f64(z+i);
+		vst1q_f64(r+i,vsqrtq_f64(vaddq_f64(vaddq_f64(vmulq_f64(a,a),vmulq_f64(b,b)),vmulq_f64(c,c))));
+	}
+	magnitude_3d_scalar(r+i,x+i,y+i,z+i,n-i);
+}
+ROUTINES_NO_CONTRACT
+static void det_2d_neon(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n)
+{
+	size_t i = 0;
+	for(;i+2<=n;i+=2)
+		vst1q_f64(r+i,vsubq_f64(vmulq_f64(vld1q_f64(a00+i),vld1q_f64(a11+i)),vmulq_f64(vld1q_f64(a01+i),vld1q_f64(a10+i))));
+	det_2d_scalar(r+i,a00+i,a01+i,a10+i,a11+i,n-i);
+}
+ROUTINES_NO_CONTRACT
+static void det_3d_neon(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n)
+{
+	size_t i = 0;
+	for(;i+2<=n;i+=2)
+	{
+		float64x2_t b00 = vld1q_f64(a00+i), b01 = vld1q_f64(a01+i), b02 = vld1q_f64(a02+i);
+		float64x2_t b10 = vld1q_f64(a10+i), b11 = vld1q_f64(a11+i), b12 = vld1q_f64(a12+i);
+		float64x2_t b20 = vld1q_f64(a20+i), b21 = vld1q_f64(a21+i), b22 = vld1q_f64(a22+i);
+		float64x2_t d   = vaddq_f64(vdupq_n_f64(0.0),vaddq_f64(vmulq_f64(vmulq_f64(b00,b11),b22),vmulq_f64(vmulq_f64(b01,b12),b20)));
+		d = vaddq_f64(d,vsubq_f64(vmulq_f64(vmulq_f64(b02,b10),b21),vmulq_f64(vmulq_f64(b02,b11),b20)));
+		d = vsubq_f64(d,vaddq_f64(vmulq_f64(vmulq_f64(b01,b10),b22),vmulq_f64(vmulq_f64(b00,b12),b21)));
+		vst1q_f64(r+i,d);
+	}
+	det_3d_scalar(r+i,a00+i,a01+i,a02+i,a10+i,a11+i,a12+i,a20+i,a21+i,a22+i,n-i);
+}
+
+/* NEON fmax/fmin propagate NaN, so no separate NaN mask is needed. */
+template<bool Max>
+static double extreme_neon(const double *x, size_t n)
+{
+	double  m;
+	size_t  i = 4;
+
+	if(n<4)
+		return extreme_scalar<Max>(x,n);
+
+	float64x2_t m0 = vld1q_f64(x), m1 = vld1q_f64(x+2);
+	for(;i+4<=n;i+=4)
+	{
+		m0 = Max ? vmaxq_f64(m0,vld1q_f64(x+i)) : vminq_f64(m0,vld1q_f64(x+i));
+		m1 = Max ? vmaxq_f64(m1,vld1q_f64(x+i+2)) : vminq_f64(m1,vld1q_f64(x+i+2));
+	}
+	m = Max ? vmaxvq_f64(vmaxq_f64(m0,m1)) : vminvq_f64(vminq_f64(m0,m1));
+	if(isnan(m))
+		return NAN;
+	if(i<n)
+	{
+		double t = extreme_scalar<Max>(x+i,n-i);
+		m = (isnan(t) || (Max ? t>m : t<m)) ? t : m;
+	}
+	return m;
+}
+static void minmax_neon(const double *x, size_t n, double *min, double *max)
+{
+	double  tlo, thi;
+	size_t  i = 2;
+
+	if(n<2)
+	{
+		minmax_scalar(x,n,min,max);
+		return;
+	}
+
+	float64x2_t l = vld1q_f64(x), h = l;
+	for(;i+2<=n;i+=2)
+	{
+		float64x2_t a = vld1q_f64(x+i);
+		l = vminq_f64(l,a);
+		h = vmaxq_f64(h,a);
+	}
+	*min = vminvq_f64(l);
+	*max = vmaxvq_f64(h);
+	if(isnan(*min) || isnan(*max))
+	{
+		*min = *max = NAN;
+		return;
+	}
+	if(i<n)
+	{
+		minmax_scalar(x+i,n-i,&tlo,&thi);
+		if(isnan(tlo))
+		{
+			*min = *max = NAN;
+			return;
+		}
+		*min = GSL_MIN_DBL(*min,tlo);
+		*max = GSL_MAX_DBL(*max,thi);
+	}
+}
+ROUTINES_NO_CONTRACT
+static double dot_neon(const double *x, const double *y, size_t n)
+{
+	size_t i = 0;
+
+	float64x2_t s0 = vdupq_n_f64(0), s1 = s0, s2 = s0, s3 = s0;
+	for(;i+8<=n;i+=8)
+	{
+		s0 = vfmaq_f64(s0,vld1q_f64(x+i),  vld1q_f64(y+i));
+		s1 = vfmaq_f64(s1,vld1q_f64(x+i+2),vld1q_f64(y+i+2));
+		s2 = vfmaq_f64(s2,vld1q_f64(x+i+4),vld1q_f64(y+i+4));
+		s3 = vfmaq_f64(s3,vld1q_f64(x+i+6),vld1q_f64(y+i+6));
+	}
+	for(;i+2<=n;i+=2)
+		s0 = vfmaq_f64(s0,vld1q_f64(x+i),vld1q_f64(y+i));
+	return vaddvq_f64(vaddq_f64(vaddq_f64(s0,s1),vaddq_f64(s2,s3))) + dot_scalar(x+i,y+i,n-i);
+}
+ROUTINES_NO_CONTRACT
+static double dot_compensated_neon(const double *x, const double *y, size_t n)
+{
+	double  ls[4], lc[4];
+	size_t  i = 0;
+
+	float64x2_t s0 = vdupq_n_f64(0), s1 = s0, c0 = s0, c1 = s0;
+	for(;i+4<=n;i+=4)
+	{
+		float64x2_t a0 = vld1q_f64(x+i),   b0 = vld1q_f64(y+i);
+		float64x2_t a1 = vld1q_f64(x+i+2), b1 = vld1q_f64(y+i+2);
+		float64x2_t p0 = vmulq_f64(a0,b0), p1 = vmulq_f64(a1,b1);
+		float64x2_t t0 = vaddq_f64(s0,p0), t1 = vaddq_f64(s1,p1);
+		float64x2_t z0 = vsubq_f64(t0,s0), z1 = vsubq_f64(t1,s1);
+		float64x2_t e0 = vaddq_f64(vsubq_f64(s0,vsubq_f64(t0,z0)),vsubq_f64(p0,z0));
+		float64x2_t e1 = vaddq_f64(vsubq_f64(s1,vsubq_f64(t1,z1)),vsubq_f64(p1,z1));
+		//vfmaq_f64(-p,a,b) = a*b - p with a single rounding
+		c0 = vaddq_f64(c0,vaddq_f64(e0,vfmaq_f64(vnegq_f64(p0),a0,b0)));
+		c1 = vaddq_f64(c1,vaddq_f64(e1,vfmaq_f64(vnegq_f64(p1),a1,b1)));
+		s0 = t0;
+		s1 = t1;
+	}
+	vst1q_f64(ls,s0);
+	vst1q_f64(ls+2,s1);
+	vst1q_f64(lc,c0);
+	vst1q_f64(lc+2,c1);
+	return dot_compensated_finish(ls,lc,4,x+i,y+i,n-i);
+}
+template<bool Max>
+static float extreme_float_neon(const float *x, size_t n)
+{
+	float   m;
+	size_t  i = 8;
+
+	if(n<8)
+		return extreme_scalar<Max>(x,n);
+
+	float32x4_t m0 = vld1q_f32(x), m1 = vld1q_f32(x+4);
+	for(;i+8<=n;i+=8)
+	{
+		m0 = Max ? vmaxq_f32(m0,vld1q_f32(x+i)) : vminq_f32(m0,vld1q_f32(x+i));
+		m1 = Max ? vmaxq_f32(m1,vld1q_f32(x+i+4)) : vminq_f32(m1,vld1q_f32(x+i+4));
+	}
+	m = Max ? vmaxvq_f32(vmaxq_f32(m0,m1)) : vminvq_f32(vminq_f32(m0,m1));
+	if(isnan(m))
+		return NAN;
+	if(i<n)
+	{
+		float t = extreme_scalar<Max>(x+i,n-i);
+		m = (isnan(t) || (Max ? t>m : t<m)) ? t : m;
+	}
+	return m;
+}
+static void minmax_float_neon(const float *x, size_t n, float *min, float *max)
+{
+	float   tlo, thi;
+	size_t  i = 4;
+
+	if(n<4)
+	{
+		minmax_scalar(x,n,min,max);
+		return;
+	}
+
+	float32x4_t l = vld1q_f32(x), h = l;
+	for(;i+4<=n;i+=4)
+	{
+		float32x4_t a = vld1q_f32(x+i);
+		l = vminq_f32(l,a);
+		h = vmaxq_f32(h,a);
+	}
+	*min = vminvq_f32(l);
+	*max = vmaxvq_f32(h);
+	if(isnan(*min) || isnan(*max))
+	{
+		*min = *max = NAN;
+		return;
+	}
+	if(i<n)
+	{
+		minmax_scalar(x+i,n-i,&tlo,&thi);
+		if(isnan(tlo))
+		{
+			*min = *max = NAN;
+			return;
+		}
+		*min = fminf(*min,tlo);
+		*max = fmaxf(*max,thi);
+	}
+}
+static double dot_float_neon(const float *x, const float *y, size_t n)
+{
+	size_t i = 0;
+
+	float64x2_t s0 = vdupq_n_f64(0), s1 = s0, s2 = s0, s3 = s0;
+	for(;i+8<=n;i+=8)
+	{
+		float32x4_t a0 = vld1q_f32(x+i),   b0 = vld1q_f32(y+i);
+		float32x4_t a1 = vld1q_f32(x+i+4), b1 = vld1q_f32(y+i+4);
+		s0 = vfmaq_f64(s0,vcvt_f64_f32(vget_low_f32(a0)),vcvt_f64_f32(vget_low_f32(b0)));
+		s1 = vfmaq_f64(s1,vcvt_high_f64_f32(a0),vcvt_high_f64_f32(b0));
+		s2 = vfmaq_f64(s2,vcvt_f64_f32(vget_low_f32(a1)),vcvt_f64_f32(vget_low_f32(b1)));
+		s3 = vfmaq_f64(s3,vcvt_high_f64_f32(a1),vcvt_high_f64_f32(b1));
+	}
+	return vaddvq_f64(vaddq_f64(vaddq_f64(s0,s1),vaddq_f64(s2,s3))) + dot_float_scalar(x+i,y+i,n-i);
+}
+#endif //ROUTINES_NEON_SIMD
+
+/*! \fn static simd_kernels simd_kernels_select(void)
+ *  \brief Pick the widest kernels this cpu supports. */
+static simd_kernels simd_kernels_select(void)
+{
+	simd_kernels k = {"scalar", cross_2d_scalar, cross_3d_scalar, dot_3d_scalar, magnitude_3d_scalar,
+	                   extreme_scalar<true>, extreme_scalar<false>, minmax_scalar, dot_scalar, dot_compensated_scalar,
+	                   det_2d_scalar, det_3d_scalar, spline_scalar,
+	                   extreme_scalar<true>, extreme_scalar<false>, minmax_scalar, dot_float_scalar, spline_float_scalar};
+
+#if defined(ROUTINES_X86_SIMD)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+	{
+		simd_kernels v = {"avx512f", cross_2d_avx512, cross_3d_avx512, dot_3d_avx512, magnitude_3d_avx512,
+		                   extreme_avx512<true>, extreme_avx512<false>, minmax_avx512, dot_avx512, dot_compensated_avx512,
+		                   det_2d_avx512, det_3d_avx512, spline_avx512,
+		                   extreme_float_avx512<true>, extreme_float_avx512<false>, minmax_float_avx512, dot_float_avx512, spline_float_avx512};
+		k = v;
+	}else if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+		simd_kernels v = {"avx2", cross_2d_avx2, cross_3d_avx2, dot_3d_avx2, magnitude_3d_avx2,
+		                   extreme_avx2<true>, extreme_avx2<false>, minmax_avx2, dot_avx2, dot_compensated_avx2,
+		                   det_2d_avx2, det_3d_avx2, spline_avx2,
+		                   extreme_float_avx2<true>, extreme_float_avx2<false>, minmax_float_avx2, dot_float_avx2, spline_float_avx2};
+		k = v;
+	}
+#elif defined(ROUTINES_NEON_SIMD)
+	simd_kernels v = {"neon", cross_2d_neon, cross_3d_neon, dot_3d_neon, magnitude_3d_neon,
+	                   extreme_neon<true>, extreme_neon<false>, minmax_neon, dot_neon, dot_compensated_neon,
+	                   det_2d_neon, det_3d_neon, spline_scalar,
+	                   extreme_float_neon<true>, extreme_float_neon<false>, minmax_float_neon, dot_float_neon, spline_float_scalar};
+	k = v;
+#endif
+	return k;
+}
+
+/*! \fn static const simd_kernels &simd(void)
+ *  \brief The kernel table, selected once on first use. */
+static const simd_kernels &simd(void)
+{
+	static const simd_kernels k = simd_kernels_select();
+	return k;
+}
+
+/*! \fn const char *simd_isa_name(void)
+ *  \brief Name of the instruction set chosen at runtime for the SIMD kernels */
+const char *simd_isa_name(void)
+{
+	return simd().name;
+}
+
+/*! \fn double array_max(double *x, size_t n)
+ *  \brief Return the maximum of an array. */
+double array_max(double *x, size_t n)
+{
+	if(n==0)
+		return NAN;
+	return simd().max(x,n);
+}
+/*! \fn double array_min(double *x, size_t n)
+ *  \brief Return the minimum of an array. */
+double array_min(double *x, size_t n)
+{
+	if(n==0)
+		return NAN;
+	return simd().min(x,n);
+}
+/*! \fn void array_minmax(double *x, size_t n, double *min, double *max)
+ *  \brief Return the minimum and maximum of an array in one pass. */
+void array_minmax(double *x, size_t n, double *min, double *max)
+{
+	if(n==0)
+	{
+		*min = *max = NAN;
+		return;
+	}
+	simd().minmax(x,n,min,max);
+}
+
+/*! \fn float array_max(float *x, size_t n)
+ *  \brief Return the maximum of a float array. */
+float array_max(float *x, size_t n)
+{
+	if(n==0)
+		return NAN;
+	return simd().max_float(x,n);
+}
+/*! \fn float array_min(float *x, size_t n)
+ *  \brief Return the minimum of a float array. */
+float array_min(float *x, size_t n)
+{
+	if(n==0)
+		return NAN;
+	return simd().min_float(x,n);
+}
+/*! \fn void array_minmax(float *x, size_t n, float *min, float *max)
+ *  \brief Return the minimum and maximum of a float array in one pass. */
+void array_minmax(float *x, size_t n, float *min, float *max)
+{
+	if(n==0)
+	{
+		*min = *max = NAN;
+		return;
+	}
+	simd().minmax_float(x,n,min,max);
+}
+
+/*! \fn double vector_cross_product(double *x, double *y, int n); 
+ *  \brief Find the cross product of x x y */
+ROUTINES_NO_CONTRACT
+double *vector_cross_product(double *x, double *y, int ndim)
+{
+	double *cp;
+
+	if(ndim==2)
+	{
+		cp = (double *) calloc(1,sizeof(double));
+		cp[0] = x[0]*y[1] -  x[1]*y[0];
+	}else{
+		cp = (double *) calloc(3,sizeof(double));
+		cp[0] = x[1]*y[2] -  x[2]*y[1];
+		cp[1] = x[2]*y[0] -  x[0]*y[2];
+		cp[2] = x[0]*y[1] -  x[1]*y[0];
+	}
+
+
+	return cp;
+}
+
+/*! \fn double *vector_cross_product(double *x, double *y, int ndim, arena *a)
+ *  \brief Find the cross product of x x y, with the result taken from arena a */
+double *vector_cross_product(double *x, double *y, int ndim, arena *a)
+{
+	double *cp = (double *) arena_alloc(a,(ndim==2) ? 1 : 3,sizeof(double));
+
+	vector_cross_product_in_place(cp,x,y,ndim);
+	return cp;
+}
+
+/*! \fn double vector_dot_product(double *x, double *y, size_t n); 
+ *  \brief Find the dot product of x * y */
+double vector_dot_product(double *x, double *y, size_t n)
+{
+	if(n==0)
+		return 0;
+	return simd().dot(x,y,n);
+}
+
+/*! \fn void vector_cross_product_in_place(double *r, double *x, double *y, int n); 
+ *  \brief Find the cross product of x x y in place*/
+ROUTINES_NO_CONTRACT
+void vector_cross_product_in_place(double *r, double *x, double *y, int ndim)
+{
+	if(ndim==2)
+	{
+		r[0] = x[0]*y[1] -  x[1]*y[0];
+	}else{
+		r[0] = x[1]*y[2] -  x[2]*y[1];
+		r[1] = x[2]*y[0] -  x[0]*y[2];
+		r[2] = x[0]*y[1] -  x[1]*y[0];
+	}
+}
+
+/*! \fn double vector_magnitude(double *x, size_t n); 
+ *  \brief Find the magnitude of x */
+double vector_magnitude(double *x, size_t n)
+{
+	if(n==0)
+		return 0;
+	return sqrt(simd().dot(x,x,n));
+}
+
+/*! \fn double vector_dot_product(float *x, float *y, size_t n)
+ *  \brief Find the dot product of float vectors x * y, accumulated in double */
+double vector_dot_product(float *x, float *y, size_t n)
+{
+	if(n==0)
+		return 0;
+	return simd().dot_float(x,y,n);
+}
+
+/*! \fn double vector_magnitude(float *x, size_t n)
+ *  \brief Find the magnitude of float vector x, accumulated in double */
+double vector_magnitude(float *x, size_t n)
+{
+	if(n==0)
+		return 0;
+	return sqrt(simd().dot_float(x,x,n));
+}
+
+/*! \def ROUTINES_PAIRWISE_BLOCK
+ *  \brief Leaf size of the pairwise summation tree. */
+#define ROUTINES_PAIRWISE_BLOCK 256
+
+/*! \fn static double dot_pairwise(const double *x, const double *y, size_t n)
+ *  \brief Pairwise dot product, SIMD kernel at the leaves. */
+static double dot_pairwise(const double *x, const double *y, size_t n)
+{
+	size_t h;
+
+	if(n<=ROUTINES_PAIRWISE_BLOCK)
+		return simd().dot(x,y,n);
+
+	//split on a block boundary so the leaves stay full width
+	h = ((n/2 + ROUTINES_PAIRWISE_BLOCK-1)/ROUTINES_PAIRWISE_BLOCK)*ROUTINES_PAIRWISE_BLOCK;
+	return dot_pairwise(x,y,h) + dot_pairwise(x+h,y+h,n-h);
+}
+
+/*! \fn double vector_dot_product(double *x, double *y, size_t n, summation_mode mode)
+ *  \brief Find the dot product of x * y with the given summation mode */
+double vector_dot_product(double *x, double *y, size_t n, summation_mode mode)
+{
+	if(n==0)
+		return 0;
+
+	switch(mode)
+	{
+		case SUMMATION_PAIRWISE:
+			return dot_pairwise(x,y,n);
+		case SUMMATION_COMPENSATED:
+			return simd().dot_compensated(x,y,n);
+		default:
+			return simd().dot(x,y,n);
+	}
+}
+
+/*! \fn double vector_magnitude(double *x, size_t n, summation_mode mode)
+ *  \brief Find the magnitude of x with the given summation mode */
+double vector_magnitude(double *x, size_t n, summation_mode mode)
+{
+	return sqrt(vector_dot_product(x,x,n,mode));
+}
+
+/*! \fn double vector_magnitude_scaled(double *x, size_t n)
+ *  \brief Find the magnitude of x without overflow or underflow */
+double vector_magnitude_scaled(double *x, size_t n)
+{
+	double buf[ROUTINES_PAIRWISE_BLOCK];
+	double lo, hi, amax, s0, s1;
+	double sum = 0;
+	int    e;
+
+	if(n==0)
+		return 0;
+
+	array_minmax(x,n,&lo,&hi);
+	amax = GSL_MAX_DBL(fabs(lo),fabs(hi));
+	if(isnan(amax) || isinf(amax) || amax==0)
+		return amax;
+
+	//a power of two scale 2^-e is exact, and leaves every |x[i]*2^-e| < 1;
+	//it is applied as two halves since 2^-e is inf for subnormal amax
+	frexp(amax,&e);
+	s0 = ldexp(1.0,-e/2);
+	s1 = ldexp(1.0,-e-(-e/2));
+
+	for(size_t i=0;i<n;i+=ROUTINES_PAIRWISE_BLOCK)
+	{
+		size_t m = GSL_MIN((size_t) ROUTINES_PAIRWISE_BLOCK,n-i);
+		for(size_t j=0;j<m;j++)
+			buf[j] = (x[i+j]*s0)*s1;
+		sum += simd().dot(buf,buf,m);
+	}
+
+	return ldexp(sqrt(sum),e);
+}
+
+/*! \fn void vector_cross_product_batch_2d(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n)
+ *  \brief Find the cross products of n 2-vectors in structure-of-arrays form */
+void vector_cross_product_batch_2d(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n)
+{
+	simd().cross_2d(r,xx,xy,yx,yy,n);
+}
+
+/*! \fn void vector_cross_product_batch_3d(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+ *  \brief Find the cross products of n 3-vectors in structure-of-arrays form */
+void vector_cross_product_batch_3d(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	simd().cross_3d(rx,ry,rz,xx,xy,xz,yx,yy,yz,n);
+}
+
+/*! \fn void vector_dot_product_batch_3d(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+ *  \brief Find the dot products of n 3-vectors in structure-of-arrays form */
+void vector_dot_product_batch_3d(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+{
+	simd().dot_3d(r,xx,xy,xz,yx,yy,yz,n);
 }
 
+/*! \fn void vector_magnitude_batch_3d(double *r, const double *x, const double *y, const double *z, size_t n)
+ *  \brief Find the magnitudes of n 3-vectors in structure-of-arrays form */
+void vector_magnitude_batch_3d(double *r, const double *x, const double *y, const double *z, size_t n)
+{
+	simd().magnitude_3d(r,x,y,z,n);
+}
 
+/*! \def ROUTINES_SPLINE_GATHER_MAX
+ *  \brief Largest interval index whose offset 4k the 32-bit gathers of the
+ *         SIMD spline kernels can hold. */
+#define ROUTINES_SPLINE_GATHER_MAX (INT_MAX/4)
 
+/*! \fn void uniform_spline_eval_many(const uniform_spline *s, const double *x, int n, double *y)
+ *  \brief Evaluate a uniform spline at n points, y[i] = s(x[i]) */
+void uniform_spline_eval_many(const uniform_spline *s, const double *x, int n, double *y)
+{
+	if(n==0)
+		return;
+	if(s->n-2>ROUTINES_SPLINE_GATHER_MAX)
+		spline_scalar(y,x,n,s->c,s->xmin,s->inv_dx,(double) (s->n-2));
+	else
+		simd().spline(y,x,n,s->c,s->xmin,s->inv_dx,(double) (s->n-2));
+}
 
-/*! \fn void create_log10_spline(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
- *  \brief Routine to make a spline, interpolating in log10.
- */
-void create_log10_spline(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
+/*! \fn void uniform_spline_eval_many(const uniform_spline_float *s, const float *x, int n, float *y)
+ *  \brief Evaluate a float uniform spline at n points, y[i] = s(x[i]) */
+void uniform_spline_eval_many(const uniform_spline_float *s, const float *x, int n, float *y)
 {
-	//log10x contains the locations at which
-	//wish to evaluate the function func()
+	if(n==0)
+		return;
+	if(s->n-2>ROUTINES_SPLINE_GATHER_MAX)
+		spline_float_scalar(y,x,n,s->c,s->xmin,s->inv_dx,(float) (s->n-2));
+	else
+		simd().spline_float(y,x,n,s->c,s->xmin,s->inv_dx,(float) (s->n-2));
+}
 
-	//log10y is input unallocated
-	//we will allocate it and it will
-	//contain log10(func(x))
+/* Parallel reductions.
 
-	//n is the size of the array of log10x and log10y
-	
-	//params is the array of parameters to pass to
-	//func(x,params)
+   The input is cut into fixed ROUTINES_PARALLEL_CHUNK pieces rather than
+   one piece per thread, and every piece writes its own partial result,
+   padded to a cache line so neighbouring threads do not share one.  The
+   partials are combined serially in chunk order, which keeps the result
+   independent of the thread count and of the OpenMP schedule.  Without
+   OpenMP the same chunks are simply reduced in turn. */
 
-	//spline is the unallocated gsl_spline
+/*! \struct reduction_partial
+ *  \brief Partial result of one chunk, alone on its cache line. */
+struct reduction_partial
+{
+	double a;
+	double b;
+	char   pad[ROUTINES_ALIGNMENT - 2*sizeof(double)];
+};
 
-	//acc is the unallocated gsl_interp_accel
+/*! \fn static reduction_partial *reduction_partials(size_t n, size_t *nchunks)
+ *  \brief Allocate one partial per chunk of an n element input. */
+static reduction_partial *reduction_partials(size_t n, size_t *nchunks)
+{
+	*nchunks = (n + ROUTINES_PARALLEL_CHUNK - 1)/ROUTINES_PARALLEL_CHUNK;
+	return (reduction_partial *) calloc_aligned(*nchunks,sizeof(reduction_partial),ROUTINES_ALIGNMENT);
+}
 
-	double x;
-	double y;
+/*! \fn static double extreme_parallel(double *x, size_t n, bool max)
+ *  \brief Shared body of array_max_parallel and array_min_parallel. */
+static double extreme_parallel(double *x, size_t n, bool max)
+{
+	reduction_partial *p;
+	size_t             nc;
+	double             m;
 
-	//allocate log10y
-	log10y = calloc_double_array(n);
+	if(n<2*ROUTINES_PARALLEL_CHUNK)
+		return max ? array_max(x,n) : array_min(x,n);
 
-	//evaluate func at x locations
-	for(int i=0;i<n;i++)
-	{
-		x = pow(10.0,log10x[i]);
+	p = reduction_partials(n,&nc);
 
-		y = func(x,params);
+	#pragma omp parallel for schedule(static)
+	for(long c=0;c<(long) nc;c++)
+	{
+		size_t i0  = (size_t) c*ROUTINES_PARALLEL_CHUNK;
+		size_t len = GSL_MIN((size_t) ROUTINES_PARALLEL_CHUNK,n-i0);
+		p[c].a = max ? simd().max(x+i0,len) : simd().min(x+i0,len);
+	}
 
-		if(y<=0)
+	m = p[0].a;
+	for(size_t c=0;c<nc;c++)
+	{
+		if(isnan(p[c].a))
 		{
-			printf("func(%e) <= 0 (%e), cannot use log10 spline here.\n",x,y);
-			fflush(stdout);
-			exit(-1);
+			m = NAN;
+			break;
 		}
-		log10y[i] = log10(y);
+		if(max ? p[c].a>m : p[c].a<m)
+			m = p[c].a;
 	}
+	free_aligned(p);
 
+	return m;
+}
 
-	//allocate interpolants
-	spline = gsl_spline_alloc(gsl_interp_cspline,n);
-
-	acc    = gsl_interp_accel_alloc();
+/*! \fn double array_max_parallel(double *x, size_t n)
+ *  \brief Find the maximum of array x using all OpenMP threads */
+double array_max_parallel(double *x, size_t n)
+{
+	return extreme_parallel(x,n,true);
+}
 
-	//create interpoolation
-	gsl_spline_init(spline, log10x, log10y, n);
+/*! \fn double array_min_parallel(double *x, size_t n)
+ *  \brief Find the minimum of array x using all OpenMP threads */
+double array_min_parallel(double *x, size_t n)
+{
+	return extreme_parallel(x,n,false);
 }
 
-/*! \fn void create_linear_spline(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
- *  \brief Routine to create a spline, interpolated linear.
- */
-void create_linear_spline(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
+/*! \fn void array_minmax_parallel(double *x, size_t n, double *min, double *max)
+ *  \brief Find the minimum and maximum of array x in one pass using all OpenMP threads */
+void array_minmax_parallel(double *x, size_t n, double *min, double *max)
 {
-	//x contains the locations at which
-	//wish to evaluate the function func()
+	reduction_partial *p;
+	size_t             nc;
 
-	//y is input unallocated
-	//we will allocate it and it will
-	//contain func(x)
+	if(n<2*ROUTINES_PARALLEL_CHUNK)
+	{
+		array_minmax(x,n,min,max);
+		return;
+	}
 
-	//n is the size of the array of x and y
-	
-	//params is the array of parameters to pass to
-	//func(x,params)
+	p = reduction_partials(n,&nc);
 
-	//spline is the unallocated gsl_spline
+	#pragma omp parallel for schedule(static)
+	for(long c=0;c<(long) nc;c++)
+	{
+		size_t i0  = (size_t) c*ROUTINES_PARALLEL_CHUNK;
+		size_t len = GSL_MIN((size_t) ROUTINES_PARALLEL_CHUNK,n-i0);
+		simd().minmax(x+i0,len,&p[c].a,&p[c].b);
+	}
 
-	//acc is the unallocated gsl_interp_accel
+	*min = p[0].a;
+	*max = p[0].b;
+	for(size_t c=0;c<nc;c++)
+	{
+		if(isnan(p[c].a))
+		{
+			*min = *max = NAN;
+			break;
+		}
+		*min = GSL_MIN_DBL(*min,p[c].a);
+		*max = GSL_MAX_DBL(*max,p[c].b);
+	}
+	free_aligned(p);
+}
 
-	//allocate y
-	y = calloc_double_array(n);
+/*! \fn double vector_dot_product_parallel(double *x, double *y, size_t n)
+ *  \brief Find the dot product of x * y using all OpenMP threads */
+double vector_dot_product_parallel(double *x, double *y, size_t n)
+{
+	reduction_partial *p;
+	size_t             nc;
+	double             dot = 0;
 
-	//evaluate func at x locations
-	for(int i=0;i<n;i++)
-		y[i] = func(x[i],params);
+	if(n<2*ROUTINES_PARALLEL_CHUNK)
+		return vector_dot_product(x,y,n);
 
+	p = reduction_partials(n,&nc);
 
-	//allocate interpolants
-	spline = gsl_spline_alloc(gsl_interp_cspline,n);
+	#pragma omp parallel for schedule(static)
+	for(long c=0;c<(long) nc;c++)
+	{
+		size_t i0  = (size_t) c*ROUTINES_PARALLEL_CHUNK;
+		size_t len = GSL_MIN((size_t) ROUTINES_PARALLEL_CHUNK,n-i0);
+		p[c].a = simd().dot(x+i0,y+i0,len);
+	}
 
-	acc    = gsl_interp_accel_alloc();
+	//fixed combine order keeps the sum reproducible
+	for(size_t c=0;c<nc;c++)
+		dot += p[c].a;
+	free_aligned(p);
 
-	//create interpoolation
-	gsl_spline_init(spline, x, y, n);
+	return dot;
 }
 
-/*! \fn double array_max(double *x, int n)
- *  \brief Return the maximum of an array. */
-double array_max(double *x, int n)
+/*! \fn double vector_magnitude_parallel(double *x, size_t n)
+ *  \brief Find the magnitude of x using all OpenMP threads */
+double vector_magnitude_parallel(double *x, size_t n)
 {
-	/*double m = x[0];
-	for(int i=1;i<n;i++)
-	{
-		m = GSL_MAX_DBL(m,x[i]);
-	}*/
-	double m = gsl_stats_max(x,1,n);
-	return m;
+	return sqrt(vector_dot_product_parallel(x,x,n));
 }
-/*! \fn double array_min(double *x, int n)
- *  \brief Return the minimum of an array. */
-double array_min(double *x, int n)
+
+/* Streaming reductions.
+
+   The stream_* accumulators see an array as a sequence of pieces of any
+   length and return exactly what the in-memory routines return for the
+   whole array.  Min and max are exact in any order.  The dot product
+   reproduces vector_dot_product_parallel, which sums its partials over
+   fixed ROUTINES_PARALLEL_CHUNK pieces: the accumulator buffers input
+   until it knows whether the whole stream is shorter than two chunks
+   (when that routine does a single vector_dot_product), and after that
+   forms the same chunk partials in the same order.  Pieces that are
+   multiples of the chunk length are reduced where they lie. */
+
+/*! \fn void stream_minmax_init(stream_minmax *s)
+ *  \brief Start a streaming min/max reduction */
+void stream_minmax_init(stream_minmax *s)
 {
-	/*double m = x[0];
-	for(int i=1;i<n;i++)
-	{
-		m = GSL_MIN_DBL(m,x[i]);
-	}*/
-	double m = gsl_stats_min(x,1,n);
-	return m;
+	s->min = NAN;
+	s->max = NAN;
+	s->n   = 0;
 }
 
-/*! \fn double vector_cross_product(double *x, double *y, int n); 
- *  \brief Find the cross product of x x y */
-double *vector_cross_product(double *x, double *y, int ndim)
+/*! \fn void stream_minmax_update(stream_minmax *s, double *x, size_t n)
+ *  \brief Add the next n elements x to a streaming min/max reduction */
+void stream_minmax_update(stream_minmax *s, double *x, size_t n)
 {
-	double *cp;
+	double lo, hi;
 
-	if(ndim==2)
+	if(n==0)
+		return;
+	simd().minmax(x,n,&lo,&hi);
+
+	//a NaN once seen stays
+	if(s->n==0)
 	{
-		cp = (double *) calloc(1,sizeof(double));
-		cp[0] = x[0]*y[1] -  x[1]*y[0];
+		s->min = lo;
+		s->max = hi;
+	}else if(isnan(lo) || isnan(s->min)){
+		s->min = s->max = NAN;
 	}else{
-		cp = (double *) calloc(3,sizeof(double));
-		cp[0] = x[1]*y[2] -  x[2]*y[1];
-		cp[1] = x[2]*y[0] -  x[0]*y[2];
-		cp[2] = x[0]*y[1] -  x[1]*y[0];
+		s->min = GSL_MIN_DBL(s->min,lo);
+		s->max = GSL_MAX_DBL(s->max,hi);
 	}
+	s->n += n;
+}
 
+/*! \fn void stream_minmax_finalize(stream_minmax *s, double *min, double *max)
+ *  \brief Return the min and max of everything passed to a streaming reduction */
+void stream_minmax_finalize(stream_minmax *s, double *min, double *max)
+{
+	*min = s->min;
+	*max = s->max;
+}
 
-	return cp;
+/*! \fn void stream_dot_init(stream_dot *s)
+ *  \brief Start a streaming dot product */
+void stream_dot_init(stream_dot *s)
+{
+	s->sum     = 0;
+	s->n       = 0;
+	s->flushed = false;
+	s->x = (double *) calloc_aligned(2*ROUTINES_PARALLEL_CHUNK,sizeof(double),ROUTINES_ALIGNMENT);
+	s->y = (double *) calloc_aligned(2*ROUTINES_PARALLEL_CHUNK,sizeof(double),ROUTINES_ALIGNMENT);
 }
 
-/*! \fn double vector_dot_product(double *x, double *y, int n); 
- *  \brief Find the dot product of x * y */
-double vector_dot_product(double *x, double *y, int n)
+/*! \fn void stream_dot_update(stream_dot *s, double *x, double *y, size_t n)
+ *  \brief Add the next n elements of x and y to a streaming dot product */
+void stream_dot_update(stream_dot *s, double *x, double *y, size_t n)
 {
-	double dot = 0;
+	const size_t chunk = ROUTINES_PARALLEL_CHUNK;
+	size_t left = n;
+	size_t m;
 
-	for(int i=0;i<n;i++)
-		dot+=x[i]*y[i];
+	while(left>0)
+	{
+		//whole chunks need no copy once the
+		//stream is known to be long
+		if(s->flushed && s->n==0 && left>=chunk)
+		{
+			s->sum += simd().dot(x,y,chunk);
+			x    += chunk;
+			y    += chunk;
+			left -= chunk;
+			continue;
+		}
+
+		m = GSL_MIN(left,(s->flushed ? chunk : 2*chunk) - s->n);
+		memcpy(s->x+s->n,x,m*sizeof(double));
+		memcpy(s->y+s->n,y,m*sizeof(double));
+		s->n += m;
+		x    += m;
+		y    += m;
+		left -= m;
+
+		if(!s->flushed && s->n==2*chunk)
+		{
+			s->sum += simd().dot(s->x,s->y,chunk);
+			memcpy(s->x,s->x+chunk,chunk*sizeof(double));
+			memcpy(s->y,s->y+chunk,chunk*sizeof(double));
+			s->n       = chunk;
+			s->flushed = true;
+		}
+		if(s->flushed && s->n==chunk)
+		{
+			s->sum += simd().dot(s->x,s->y,chunk);
+			s->n    = 0;
+		}
+	}
+}
 
+/*! \fn double stream_dot_finalize(stream_dot *s)
+ *  \brief Return the dot product of everything passed to a streaming
+ *         dot product, and release its buffers */
+double stream_dot_finalize(stream_dot *s)
+{
+	double dot;
+
+	if(!s->flushed)
+		dot = s->n ? simd().dot(s->x,s->y,s->n) : 0;
+	else
+		dot = s->n ? s->sum + simd().dot(s->x,s->y,s->n) : s->sum;
+
+	free_aligned(s->x);
+	free_aligned(s->y);
+	s->x = s->y = NULL;
 	return dot;
 }
 
-/*! \fn void vector_cross_product_in_place(double *r, double *x, double *y, int n); 
- *  \brief Find the cross product of x x y in place*/
-void vector_cross_product_in_place(double *r, double *x, double *y, int ndim)
+/*! \struct chunk_reader
+ *  \brief Reads the elements of an array file in chunks, one chunk ahead. */
+struct chunk_reader
 {
-	if(ndim==2)
+	FILE  *fp;
+	size_t left;	//elements not yet requested from the file
+	size_t chunk;
+	double *buf[2];
+	int    next;	//buffer the pending read fills
+	size_t pending_n;
+	std::future<size_t> pending;
+};
+
+/*! \fn static void chunk_reader_start(chunk_reader *r)
+ *  \brief Begin reading the next chunk into the free buffer in the background. */
+static void chunk_reader_start(chunk_reader *r)
+{
+	double *b  = r->buf[r->next];
+	FILE   *fp = r->fp;
+	size_t  k  = GSL_MIN(r->left,r->chunk);
+
+	r->pending_n = k;
+	r->left     -= k;
+	r->pending   = std::async(std::launch::async,[=]() { return fread(b,sizeof(double),k,fp); });
+}
+
+/*! \fn chunk_reader *chunk_reader_open(FILE *fp, int rank, size_t chunk)
+ *  \brief Start reading a rank dimensional array file in chunks of doubles */
+chunk_reader *chunk_reader_open(FILE *fp, int rank, size_t chunk)
+{
+	chunk_reader *r = new chunk_reader;
+	size_t shape[ROUTINES_ARRAY_MAX_RANK];
+	size_t bytes;
+	bool   ok = true;
+
+	if(chunk==0)
 	{
-		r[0] = x[0]*y[1] -  x[1]*y[0];
-	}else{
-		r[0] = x[1]*y[2] -  x[2]*y[1];
-		r[1] = x[2]*y[0] -  x[0]*y[2];
-		r[2] = x[0]*y[1] -  x[1]*y[0];
+		printf("Error: chunk_reader_open chunk = 0.\n");
+		fflush(stdout);
+		exit(-1);
+	}
+
+	read_array_header(fp,DTYPE_DOUBLE,rank,shape);
+	r->fp    = fp;
+	r->chunk = chunk;
+	r->left  = 1;
+	for(int d=0;d<rank;d++)
+		ok = ok && extent_multiply(r->left,shape[d],&r->left);
+	if(!ok || !extent_multiply(r->left,sizeof(double),&bytes))
+	{
+		printf("Error: chunk_reader_open header shape too large for any file (overflow).\n");
+		fflush(stdout);
+		exit(-1);
 	}
+	r->buf[0] = (double *) calloc_aligned(chunk,sizeof(double),ROUTINES_ALIGNMENT);
+	r->buf[1] = (double *) calloc_aligned(chunk,sizeof(double),ROUTINES_ALIGNMENT);
+	r->next   = 0;
+	r->pending_n = 0;
+	if(r->left)
+		chunk_reader_start(r);
+	return r;
 }
 
-/*! \fn double vector_magnitude(double *x, int n); 
- *  \brief Find the magnitude of x */
-double vector_magnitude(double *x, int n)
+/*! \fn size_t chunk_reader_next(chunk_reader *r, double **x)
+ *  \brief Point x at the next chunk and return its length, 0 at the end */
+size_t chunk_reader_next(chunk_reader *r, double **x)
 {
-	double dot = 0;
+	size_t n;
 
-	for(int i=0;i<n;i++)
-		dot+=x[i]*x[i];
+	if(!r->pending.valid())
+	{
+		*x = NULL;
+		return 0;
+	}
+
+	n = r->pending_n;
+	if(r->pending.get()!=n)
+	{
+		printf("Error reading %zu elements of %zu bytes.\n",n,sizeof(double));
+		fflush(stdout);
+		exit(-1);
+	}
 
-	return sqrt(dot);
+	//hand this chunk out and fill the other
+	//buffer while the caller works on it
+	*x      = r->buf[r->next];
+	r->next = 1 - r->next;
+	if(r->left)
+		chunk_reader_start(r);
+	return n;
 }
 
-/*! \fn double **tensor_transformation(double **a, double **sigma, int ndim)
- *  \brief Apply transformation a to tensor sigma */
-double **tensor_transformation(double **a, double **sigma, int ndim)
+/*! \fn void chunk_reader_close(chunk_reader *r)
+ *  \brief Finish with a chunk reader; the FILE stays open */
+void chunk_reader_close(chunk_reader *r)
+{
+	if(r->pending.valid())
+		r->pending.wait();
+	free_aligned(r->buf[0]);
+	free_aligned(r->buf[1]);
+	delete r;
+}
+
+/*! \def ROUTINES_TENSOR_STACK
+ *  \brief Largest ndim whose tensor_transformation scratch lives on the stack. */
+#define ROUTINES_TENSOR_STACK 8
+
+/*! \fn static void tensor_transformation_compute(double **result_A, double **a, double **sigma, int ndim)
+ *  \brief Write the transformation a sigma a^T into result_A */
+ROUTINES_NO_CONTRACT
+static void tensor_transformation_compute(double **result_A, double **a, double **sigma, int ndim)
 {
 
 	/* A tensor transformation of the form:
@@ -488,52 +5657,262 @@ double **tensor_transformation(double **a, double **sigma, int ndim)
 			|  sum_j a_xj sum_i a_xi s_ji		sum_j a_xj sum_i a_yi s_ji |
 			|  sum_j a_yj sum_i a_xi s_ji		sum_j a_yj sum_i a_yi s_ji |
 			----								----
+
+		The inner sums y_jm = sum_i a_mi s_ji do not depend on n, so
+		they are formed once (t = sigma a^T), making this O(ndim^3).
+		The sums are taken in the same order as the direct O(ndim^4)
+		form, so the result is identical to it.
 	*/
 
-	double **result_A;
-	double x;
-	double y;
+	double  stack[ROUTINES_TENSOR_STACK*ROUTINES_TENSOR_STACK];
+	double *t = stack;
+	double  x;
+	double  y;
+
+	if(ndim>ROUTINES_TENSOR_STACK)
+		t = calloc_double_array(ndim*ndim);
 
-	result_A = two_dimensional_array(ndim, ndim);
+	//t_jm = sigma_ji a_mi
+	for(int j=0;j<ndim;j++)
+	{
+		for(int m=0;m<ndim;m++)
+		{
+			y = 0.0;
+			for(int i=0;i<ndim;i++)
+				y += a[m][i]*sigma[j][i];
+			t[j*ndim+m] = y;
+		}
+	}
 
-	//do a*(sigma a^T) = a_nj a_mi sigma_ji //einstein notation
+	//do a*(sigma a^T) = a_nj t_jm //einstein notation
 	for(int n=0;n<ndim;n++)
 	{
 		for(int m=0;m<ndim;m++)
 		{
 			x = 0.0;
 			for(int j=0;j<ndim;j++)
-			{
-				y = 0.0;
-				for(int i=0;i<ndim;i++)
-					y += a[m][i]*sigma[j][i];
-			
-				x += a[n][j]*y;
-			}
+				x += a[n][j]*t[j*ndim+m];
 
 			result_A[n][m] = x;
 		}
 	}
 
+	if(t!=stack)
+		free(t);
+}
+
+/*! \fn static void tensor_transformation_flat<N>(double *r, const double *a, const double *sigma)
+ *  \brief tensor_transformation_compute for flat row-major NxN tensors,
+ *         with N known at compile time and scratch t on the stack. */
+template<int N>
+ROUTINES_NO_CONTRACT
+static inline void tensor_transformation_flat(double *r, const double *a, const double *sigma)
+{
+	double t[N*N];
+
+	for(int j=0;j<N;j++)
+		for(int m=0;m<N;m++)
+		{
+			double y = 0.0;
+			for(int i=0;i<N;i++)
+				y += a[m*N+i]*sigma[j*N+i];
+			t[j*N+m] = y;
+		}
+	for(int n=0;n<N;n++)
+		for(int m=0;m<N;m++)
+		{
+			double x = 0.0;
+			for(int j=0;j<N;j++)
+				x += a[n*N+j]*t[j*N+m];
+			r[n*N+m] = x;
+		}
+}
+
+/*! \fn static void tensor_transformation_flat(double *r, const double *a, const double *sigma, double *t, int ndim)
+ *  \brief tensor_transformation_compute for flat row-major tensors of any ndim,
+ *         with caller-provided ndim*ndim scratch t. */
+ROUTINES_NO_CONTRACT
+static void tensor_transformation_flat(double *r, const double *a, const double *sigma, double *t, int ndim)
+{
+	for(int j=0;j<ndim;j++)
+		for(int m=0;m<ndim;m++)
+		{
+			double y = 0.0;
+			for(int i=0;i<ndim;i++)
+				y += a[m*ndim+i]*sigma[j*ndim+i];
+			t[j*ndim+m] = y;
+		}
+	for(int n=0;n<ndim;n++)
+		for(int m=0;m<ndim;m++)
+		{
+			double x = 0.0;
+			for(int j=0;j<ndim;j++)
+				x += a[n*ndim+j]*t[j*ndim+m];
+			r[n*ndim+m] = x;
+		}
+}
+
+/*! \fn void tensor_transformation_in_place(double **result, double **a, double **sigma, int ndim)
+ *  \brief Apply transformation a to tensor sigma, writing into result */
+void tensor_transformation_in_place(double **result, double **a, double **sigma, int ndim)
+{
+	tensor_transformation_compute(result, a, sigma, ndim);
+}
+
+/*! \fn void tensor_transformation_batch(double *result, const double *a, const double *sigma, int ndim, size_t count)
+ *  \brief Apply one transformation a to count contiguous tensors sigma */
+ROUTINES_NO_CONTRACT
+void tensor_transformation_batch(double *result, const double *a, const double *sigma, int ndim, size_t count)
+{
+	size_t nn = (size_t) ndim*ndim;
+
+	//the common dimensions get fully unrolled kernels
+	if(ndim==3)
+	{
+		#pragma omp parallel for schedule(static) if(count>=ROUTINES_PARALLEL_CHUNK)
+		for(long k=0;k<(long) count;k++)
+			tensor_transformation_flat<3>(result+k*nn, a, sigma+k*nn);
+	}else if(ndim==2){
+		#pragma omp parallel for schedule(static) if(count>=ROUTINES_PARALLEL_CHUNK)
+		for(long k=0;k<(long) count;k++)
+			tensor_transformation_flat<2>(result+k*nn, a, sigma+k*nn);
+	}else{
+		#pragma omp parallel if(count>=ROUTINES_PARALLEL_CHUNK)
+		{
+			double *t = calloc_double_array(nn);
+
+			#pragma omp for schedule(static)
+			for(long k=0;k<(long) count;k++)
+				tensor_transformation_flat(result+k*nn, a, sigma+k*nn, t, ndim);
+			free(t);
+		}
+	}
+}
+
+/*! \fn double **tensor_transformation(double **a, double **sigma, int ndim)
+ *  \brief Apply transformation a to tensor sigma */
+double **tensor_transformation(double **a, double **sigma, int ndim)
+{
+	double **result_A;
+
+	result_A = two_dimensional_array(ndim, ndim, ARRAY_UNINITIALIZED);
+	tensor_transformation_compute(result_A, a, sigma, ndim);
+
 	//return transformed tensor
 	return result_A;
 }
 
+/*! \fn double **tensor_transformation(double **a, double **sigma, int ndim, arena *ar)
+ *  \brief Apply transformation a to tensor sigma, with the result taken
+ *         from arena ar */
+double **tensor_transformation(double **a, double **sigma, int ndim, arena *ar)
+{
+	double **result_A;
+
+	result_A = two_dimensional_contiguous_array(ndim, ndim, ar, ARRAY_UNINITIALIZED);
+	tensor_transformation_compute(result_A, a, sigma, ndim);
+
+	return result_A;
+}
+
+/*! \fn double matrix_determinant_in_place(double *a, int ndim)
+ *  \brief Find the determinant of a flat row-major (ndim x ndim) matrix
+ *         by LU decomposition with partial pivoting, overwriting a with
+ *         the factors. */
+double matrix_determinant_in_place(double *a, int ndim)
+{
+	double det = 1;
+	double f;
+	double *p, *q;
+	int imax;
+
+	for(int k=0;k<ndim;k++)
+	{
+		//choose the largest pivot in column k
+		imax = k;
+		for(int i=k+1;i<ndim;i++)
+			if(fabs(a[i*ndim+k])>fabs(a[imax*ndim+k]))
+				imax = i;
+
+		p = a + k*ndim;
+		if(imax!=k)
+		{
+			q = a + imax*ndim;
+			for(int j=k;j<ndim;j++)
+			{
+				f    = p[j];
+				p[j] = q[j];
+				q[j] = f;
+			}
+			det = -det;
+		}
+
+		det *= p[k];
+		if(p[k]==0)
+			return det;
+
+		//eliminate below the pivot
+		for(int i=k+1;i<ndim;i++)
+		{
+			q = a + i*ndim;
+			f = q[k]/p[k];
+			q[k] = f;
+			for(int j=k+1;j<ndim;j++)
+				q[j] -= f*p[j];
+		}
+	}
+	return det;
+}
+
 /*! \fn double matrix_determinant(double **a, int ndim)
  *  \brief Find the determinant of a matrix or tensor */
+ROUTINES_NO_CONTRACT
 double matrix_determinant(double **a, int ndim)
 {
 	double det;
-	//only works for 2 or 3 dimensions
+	double  stack[ROUTINES_TENSOR_STACK*ROUTINES_TENSOR_STACK];
+	double *lu = stack;
 
-	if(ndim==2)
-	{	
+	if(ndim<1)
+	{
+		printf("Error: matrix_determinant ndim = %d.\n",ndim);
+		fflush(stdout);
+		exit(-1);
+	}
+
+	if(ndim==1)
+	{
+		det = a[0][0];
+	}else if(ndim==2){
 		det =  a[0][0]*a[1][1]-a[1][0]*a[0][1];
-	}else{
+	}else if(ndim==3){
 		det  = 0;
 		det += a[0][0]*a[1][1]*a[2][2] + a[0][1]*a[1][2]*a[2][0];
 		det += a[0][2]*a[1][0]*a[2][1] - a[0][2]*a[1][1]*a[2][0];
 		det -= a[0][1]*a[1][0]*a[2][2] + a[0][0]*a[1][2]*a[2][1];
+	}else{
+		//factor a copy, so a may be a row table of any layout
+		if(ndim>ROUTINES_TENSOR_STACK)
+			lu = calloc_double_array(ndim*ndim);
+		for(int i=0;i<ndim;i++)
+			memcpy(lu+i*ndim,a[i],ndim*sizeof(double));
+		det = matrix_determinant_in_place(lu,ndim);
+		if(lu!=stack)
+			free(lu);
 	}
 	return det;
 }
+
+/*! \fn void matrix_determinant_batch_2d(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n)
+ *  \brief Find the determinants of n 2x2 matrices in structure-of-arrays form */
+void matrix_determinant_batch_2d(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n)
+{
+	simd().det_2d(r,a00,a01,a10,a11,n);
+}
+
+/*! \fn void matrix_determinant_batch_3d(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n)
+ *  \brief Find the determinants of n 3x3 matrices in structure-of-arrays form */
+void matrix_determinant_batch_3d(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n)
+{
+	simd().det_3d(r,a00,a01,a02,a10,a11,a12,a20,a21,a22,n);
+}
@@ -21,54 +21,565 @@ int       check_file(char fname[]);
  *  \brief Safe method for opening a FILE pointer.
  */
 FILE     *fopen_brant(char fname[], const char *mode);
-/*! \fn double *calloc_double_array(int n)
+/*! \fn FILE *try_fopen_brant(const char *fname, const char *mode)
+ *  \brief As fopen_brant, but returns NULL with errno set by fopen
+ *         instead of exiting.
+ *
+ *  The try_* routines are the non-aborting forms of the allocators and
+ *  fopen_brant, for long-running callers that can recover, e.g. by
+ *  retrying with smaller tiles.  On success they return exactly what
+ *  the aborting routine would; on failure they release anything they
+ *  had allocated and return NULL with errno set, ENOMEM for a failed
+ *  or overflowing allocation and EINVAL for a bad alignment.
+ */
+FILE     *try_fopen_brant(const char *fname, const char *mode);
+/*! \fn double *calloc_double_array(size_t n)
  *  \brief Safe method for callocing a double array
  */
-double   *calloc_double_array(int n);
-/*! \fn float *calloc_float_array(int n)
+double   *calloc_double_array(size_t n);
+/*! \fn float *calloc_float_array(size_t n)
  *  \brief Safe method for callocing a float array
  */
-float    *calloc_float_array(int n);
-/*! \fn int *calloc_int_array(int n)
+float    *calloc_float_array(size_t n);
+/*! \fn int *calloc_int_array(size_t n)
  *  \brief Safe method for callocing an int array
  */
-int      *calloc_int_array(int n);
-/*! \fn size_t *calloc_size_t_array(int n)
+int      *calloc_int_array(size_t n);
+/*! \fn size_t *calloc_size_t_array(size_t n)
  *  \brief Safe method for callocing a size_t array
  */
-size_t   *calloc_size_t_array(int n);
-/*! \fn double **two_dimensional_array(int n, int l)
- *  \brief Allocate a two dimensional (n x l) array
+size_t   *calloc_size_t_array(size_t n);
+/*! \fn double *try_calloc_double_array(size_t n)
+ *  \brief As calloc_double_array, but returns NULL on failure (see try_fopen_brant)
+ */
+double   *try_calloc_double_array(size_t n);
+/*! \fn float *try_calloc_float_array(size_t n)
+ *  \brief As calloc_float_array, but returns NULL on failure
+ */
+float    *try_calloc_float_array(size_t n);
+/*! \fn int *try_calloc_int_array(size_t n)
+ *  \brief As calloc_int_array, but returns NULL on failure
+ */
+int      *try_calloc_int_array(size_t n);
+/*! \fn size_t *try_calloc_size_t_array(size_t n)
+ *  \brief As calloc_size_t_array, but returns NULL on failure
+ */
+size_t   *try_calloc_size_t_array(size_t n);
+/*! \def ROUTINES_ALIGNMENT
+ *  \brief Default alignment in bytes for the calloc_aligned_* routines,
+ *         one cache line and one AVX-512 register. */
+#define   ROUTINES_ALIGNMENT      64
+/*! \def ROUTINES_MAX_ALIGNMENT
+ *  \brief Largest alignment accepted by calloc_aligned, one 2 MB huge page. */
+#define   ROUTINES_MAX_ALIGNMENT  2097152
+/*! \fn void *calloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief Safe method for allocating a zeroed array of n elements of size
+ *         bytes whose address is a multiple of alignment.  alignment must
+ *         be a power of two between sizeof(void *) and ROUTINES_MAX_ALIGNMENT.
+ *         Release with free_aligned.
+ */
+void     *calloc_aligned(size_t n, size_t size, size_t alignment);
+/*! \fn void free_aligned(void *p)
+ *  \brief Release memory from calloc_aligned, calloc_numa or the calloc_aligned_* routines.
+ *         Arrays from the calloc_*_array routines may also be released
+ *         with it, which keeps alloc_report's count of them right.
+ */
+void      free_aligned(void *p);
+/*! \enum huge_page_mode
+ *  \brief Pages backing allocations of at least the huge_pages_set threshold.
+ *
+ *  HUGE_PAGES_TRANSPARENT (the default) aligns them to 2 MB and asks the
+ *  kernel, with madvise(MADV_HUGEPAGE), to back them with transparent
+ *  huge pages.  HUGE_PAGES_2MB and HUGE_PAGES_1GB map explicit huge pages
+ *  from the vm.nr_hugepages pool with MAP_HUGETLB, falling back to
+ *  transparent ones when the pool is empty.  HUGE_PAGES_NONE uses
+ *  ordinary pages.
+ */
+enum huge_page_mode {HUGE_PAGES_NONE, HUGE_PAGES_TRANSPARENT, HUGE_PAGES_2MB, HUGE_PAGES_1GB};
+/*! \def ROUTINES_HUGE_PAGE_THRESHOLD
+ *  \brief Default size in bytes from which allocations use huge pages (32 MB). */
+#define   ROUTINES_HUGE_PAGE_THRESHOLD 33554432
+/*! \fn void huge_pages_set(huge_page_mode mode, size_t threshold)
+ *  \brief Choose the pages used by calloc_aligned, and so the contiguous
+ *         N-dimensional arrays and arenas, and by calloc_numa, for
+ *         allocations of threshold bytes or more.  The calloc_*_array
+ *         routines, whose arrays are released with free, only ever use
+ *         transparent huge pages.  Affects later allocations only.
+ */
+void      huge_pages_set(huge_page_mode mode, size_t threshold = ROUTINES_HUGE_PAGE_THRESHOLD);
+/*! \fn double *calloc_aligned_double_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned double array
+ */
+double   *calloc_aligned_double_array(size_t n, size_t alignment = ROUTINES_ALIGNMENT);
+/*! \fn float *calloc_aligned_float_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned float array
+ */
+float    *calloc_aligned_float_array(size_t n, size_t alignment = ROUTINES_ALIGNMENT);
+/*! \fn int *calloc_aligned_int_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned int array
  */
-double  **two_dimensional_array(int n, int l);
-/*! \fn void deallocate_two_dimensional_array(double **x, int n, int l)
+int      *calloc_aligned_int_array(size_t n, size_t alignment = ROUTINES_ALIGNMENT);
+/*! \fn size_t *calloc_aligned_size_t_array(size_t n, size_t alignment)
+ *  \brief Safe method for callocing an aligned size_t array
+ */
+size_t   *calloc_aligned_size_t_array(size_t n, size_t alignment = ROUTINES_ALIGNMENT);
+/*! \fn void *malloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief As calloc_aligned, but the memory is left uninitialized.
+ *         Release with free_aligned.
+ */
+void     *malloc_aligned(size_t n, size_t size, size_t alignment = ROUTINES_ALIGNMENT);
+/*! \fn void *try_calloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief As calloc_aligned, but returns NULL on failure
+ */
+void     *try_calloc_aligned(size_t n, size_t size, size_t alignment = ROUTINES_ALIGNMENT);
+/*! \fn void *try_malloc_aligned(size_t n, size_t size, size_t alignment)
+ *  \brief As malloc_aligned, but returns NULL on failure
+ */
+void     *try_malloc_aligned(size_t n, size_t size, size_t alignment = ROUTINES_ALIGNMENT);
+/*! \enum array_init
+ *  \brief How the N-dimensional allocators initialize the elements.
+ *
+ *  ARRAY_UNINITIALIZED skips initialization, for arrays about to be
+ *  overwritten.  ARRAY_ZEROED zeroes them, with calloc_aligned's fresh
+ *  zero pages where possible for the contiguous arrays.  ARRAY_FILLED
+ *  sets every element to the value argument.
+ */
+enum array_init {ARRAY_UNINITIALIZED, ARRAY_ZEROED, ARRAY_FILLED};
+/*! \fn double **two_dimensional_array(size_t n, size_t l, array_init init, double value)
+ *  \brief Allocate a two dimensional (n x l) array, zeroed by default
+ */
+double  **two_dimensional_array(size_t n, size_t l, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn void deallocate_two_dimensional_array(double **x, size_t n, size_t l)
  *  \brief De-allocate a two dimensional (n x l) array
  */
-void      deallocate_two_dimensional_array(double **x, int n, int l);
-/*! \fn double ***three_dimensional_array(int n, int l, int m)
- *  \brief Allocate a three dimensional (n x l x m) array 
+void      deallocate_two_dimensional_array(double **x, size_t n, size_t l);
+/*! \fn double ***three_dimensional_array(size_t n, size_t l, size_t m, array_init init, double value)
+ *  \brief Allocate a three dimensional (n x l x m) array, uninitialized by default
  */
-double ***three_dimensional_array(int n, int l, int m);
-/*! \fn void deallocate_three_dimensional_array(double ***x, int n, int l, int m)
+double ***three_dimensional_array(size_t n, size_t l, size_t m, array_init init = ARRAY_UNINITIALIZED, double value = 0);
+/*! \fn void deallocate_three_dimensional_array(double ***x, size_t n, size_t l, size_t m)
  *  \brief De-allocate a three dimensional (n x l x m) array
  */
-void      deallocate_three_dimensional_array(double ***x, int n, int l, int m);
-/*! \fn int ***three_dimensional_int_array(int n, int l, int m)
- *  \brief Allocate a three dimensional (n x l x m) int array
+void      deallocate_three_dimensional_array(double ***x, size_t n, size_t l, size_t m);
+/*! \fn double ****four_dimensional_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+ *  \brief Allocate a four dimensional (n x l x m x p) array, uninitialized by default
  */
-double ****four_dimensional_array(int n, int l, int m, int p);
-/*! \fn void deallocate_four_dimensional_array(double ****x, int n, int l, int m, int p)
+double ****four_dimensional_array(size_t n, size_t l, size_t m, size_t p, array_init init = ARRAY_UNINITIALIZED, double value = 0);
+/*! \fn void deallocate_four_dimensional_array(double ****x, size_t n, size_t l, size_t m, size_t p)
  *  \brief De-allocate a four dimensional (n x l x m x p) array
  */
-void      deallocate_four_dimensional_array(double ****x, int n, int l, int m, int p);
-/*! \fn int ***three_dimensional_int_array(int n, int l, int m, int p)
- *  \brief Allocate a three dimensional (n x l x m) int array
+void      deallocate_four_dimensional_array(double ****x, size_t n, size_t l, size_t m, size_t p);
+/*! \fn int ***three_dimensional_int_array(size_t n, size_t l, size_t m, array_init init, int value)
+ *  \brief Allocate a three dimensional (n x l x m) int array, uninitialized by default
  */
-int    ***three_dimensional_int_array(int n, int l, int m);
-/*! \fn void deallocate_three_int_dimensional_array(int ***x, int n, int l, int m)
+int    ***three_dimensional_int_array(size_t n, size_t l, size_t m, array_init init = ARRAY_UNINITIALIZED, int value = 0);
+/*! \fn void deallocate_three_dimensional_int_array(int ***x, size_t n, size_t l, size_t m)
  *  \brief De-allocate a three dimensional (n x l x m) int array.
  */
-void      deallocate_three_dimensional_int_array(int ***x, int n, int l, int m);
+void      deallocate_three_dimensional_int_array(int ***x, size_t n, size_t l, size_t m);
+/*! \fn double **two_dimensional_contiguous_array(size_t n, size_t l, array_init init, double value)
+ *  \brief Allocate a two dimensional (n x l) array backed by a single
+ *         contiguous slab of n*l doubles, zeroed by default.  x[i][j]
+ *         indexing works as for two_dimensional_array, and x[0] points to
+ *         the whole slab, which is aligned to ROUTINES_ALIGNMENT.
+ */
+double  **two_dimensional_contiguous_array(size_t n, size_t l, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn void deallocate_two_dimensional_contiguous_array(double **x, size_t n, size_t l)
+ *  \brief De-allocate an array from two_dimensional_contiguous_array
+ */
+void      deallocate_two_dimensional_contiguous_array(double **x, size_t n, size_t l);
+/*! \fn double **try_two_dimensional_contiguous_array(size_t n, size_t l, array_init init, double value)
+ *  \brief As two_dimensional_contiguous_array, but returns NULL on failure
+ */
+double  **try_two_dimensional_contiguous_array(size_t n, size_t l, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init, double value)
+ *  \brief Allocate a three dimensional (n x l x m) array backed by a single
+ *         contiguous slab aligned to ROUTINES_ALIGNMENT, zeroed by default.
+ *         x[0][0] points to the whole slab.
+ */
+double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn void deallocate_three_dimensional_contiguous_array(double ***x, size_t n, size_t l, size_t m)
+ *  \brief De-allocate an array from three_dimensional_contiguous_array
+ */
+void      deallocate_three_dimensional_contiguous_array(double ***x, size_t n, size_t l, size_t m);
+/*! \fn double ***try_three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init, double value)
+ *  \brief As three_dimensional_contiguous_array, but returns NULL on failure
+ */
+double ***try_three_dimensional_contiguous_array(size_t n, size_t l, size_t m, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+ *  \brief Allocate a four dimensional (n x l x m x p) array backed by a single
+ *         contiguous slab aligned to ROUTINES_ALIGNMENT, zeroed by default.
+ *         x[0][0][0] points to the whole slab.
+ */
+double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn void deallocate_four_dimensional_contiguous_array(double ****x, size_t n, size_t l, size_t m, size_t p)
+ *  \brief De-allocate an array from four_dimensional_contiguous_array
+ */
+void      deallocate_four_dimensional_contiguous_array(double ****x, size_t n, size_t l, size_t m, size_t p);
+/*! \fn double ****try_four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init, double value)
+ *  \brief As four_dimensional_contiguous_array, but returns NULL on failure
+ */
+double ****try_four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn int ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, array_init init, int value)
+ *  \brief Allocate a three dimensional (n x l x m) int array backed by a single
+ *         contiguous slab aligned to ROUTINES_ALIGNMENT, zeroed by default.
+ *         x[0][0] points to the whole slab.
+ */
+int    ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, array_init init = ARRAY_ZEROED, int value = 0);
+/*! \fn void deallocate_three_dimensional_contiguous_int_array(int ***x, size_t n, size_t l, size_t m)
+ *  \brief De-allocate an array from three_dimensional_contiguous_int_array
+ */
+void      deallocate_three_dimensional_contiguous_int_array(int ***x, size_t n, size_t l, size_t m);
+/*! \fn float **two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init, float value)
+ *  \brief Allocate a two dimensional (n x l) float array backed by a single
+ *         contiguous slab aligned to ROUTINES_ALIGNMENT, zeroed by default.
+ *         x[0] points to the whole slab.
+ */
+float   **two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init = ARRAY_ZEROED, float value = 0);
+/*! \fn void deallocate_two_dimensional_contiguous_float_array(float **x, size_t n, size_t l)
+ *  \brief De-allocate an array from two_dimensional_contiguous_float_array
+ */
+void      deallocate_two_dimensional_contiguous_float_array(float **x, size_t n, size_t l);
+/*! \fn float **try_two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init, float value)
+ *  \brief As two_dimensional_contiguous_float_array, but returns NULL on failure
+ */
+float   **try_two_dimensional_contiguous_float_array(size_t n, size_t l, array_init init = ARRAY_ZEROED, float value = 0);
+/*! \fn float ***three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init, float value)
+ *  \brief Allocate a three dimensional (n x l x m) float array backed by a single
+ *         contiguous slab aligned to ROUTINES_ALIGNMENT, zeroed by default.
+ *         x[0][0] points to the whole slab.
+ */
+float  ***three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init = ARRAY_ZEROED, float value = 0);
+/*! \fn void deallocate_three_dimensional_contiguous_float_array(float ***x, size_t n, size_t l, size_t m)
+ *  \brief De-allocate an array from three_dimensional_contiguous_float_array
+ */
+void      deallocate_three_dimensional_contiguous_float_array(float ***x, size_t n, size_t l, size_t m);
+/*! \fn float ***try_three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init, float value)
+ *  \brief As three_dimensional_contiguous_float_array, but returns NULL on failure
+ */
+float  ***try_three_dimensional_contiguous_float_array(size_t n, size_t l, size_t m, array_init init = ARRAY_ZEROED, float value = 0);
+/*! \enum numa_placement
+ *  \brief Where the pages of a calloc_numa slab are placed.
+ *
+ *  NUMA_FIRST_TOUCH faults every page in from the OpenMP thread that a
+ *  "#pragma omp parallel for schedule(static)" loop over the slab's
+ *  first index would give it, with the current number of threads, so
+ *  loops with that partition read memory on their own socket.
+ *  NUMA_INTERLEAVE spreads the pages round-robin over all nodes, for data
+ *  read by every thread.  NUMA_BIND puts them all on one node.
+ */
+enum numa_placement {NUMA_FIRST_TOUCH, NUMA_INTERLEAVE, NUMA_BIND};
+/*! \def ROUTINES_NUMA_MIN_BYTES
+ *  \brief Slabs smaller than this come from calloc_aligned and are not
+ *         placed; it is not worth a mapping each. */
+#define   ROUTINES_NUMA_MIN_BYTES 1048576
+/*! \fn void *calloc_numa(size_t n, size_t size, numa_placement placement, int node)
+ *  \brief Allocate a zeroed, page aligned array of n elements of size
+ *         bytes with its pages placed as placement asks, on node for
+ *         NUMA_BIND.  With NUMA_FIRST_TOUCH the partition is by element.
+ *         Placement is a hint: where the kernel refuses it (one node, a
+ *         restricted cpuset) pages go to whichever thread touches them
+ *         first.  Release with free_aligned.
+ */
+void     *calloc_numa(size_t n, size_t size, numa_placement placement, int node = 0);
+/*! \fn double **two_dimensional_contiguous_array(size_t n, size_t l, numa_placement placement, int node)
+ *  \brief As two_dimensional_contiguous_array, with the slab from calloc_numa
+ *         and, for NUMA_FIRST_TOUCH, partitioned by row.  Release with
+ *         deallocate_two_dimensional_contiguous_array.
+ */
+double  **two_dimensional_contiguous_array(size_t n, size_t l, numa_placement placement, int node = 0);
+/*! \fn double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, numa_placement placement, int node)
+ *  \brief As three_dimensional_contiguous_array, with the slab from calloc_numa
+ *         and, for NUMA_FIRST_TOUCH, partitioned by x[i].  Release with
+ *         deallocate_three_dimensional_contiguous_array.
+ */
+double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, numa_placement placement, int node = 0);
+/*! \fn void alloc_tracking_enable(bool enable)
+ *  \brief Turn allocation accounting on or off (default off).
+ *
+ *  While it is on, every array from the calloc_*, calloc_aligned*,
+ *  N-dimensional and arena routines is charged, with its size in bytes,
+ *  to the tag that was current in the allocating thread (see
+ *  alloc_set_tag), and credited back when it is released with its
+ *  deallocate_* routine, free_aligned or arena_destroy.  Arrays from the
+ *  calloc_*_array routines are only credited back if released with
+ *  free_aligned instead of free.  Off, each allocation and release costs
+ *  one relaxed atomic load.
+ */
+void      alloc_tracking_enable(bool enable);
+/*! \fn const char *alloc_set_tag(const char *tag)
+ *  \brief Set the tag that this thread's allocations are charged to and
+ *         return the previous one.  NULL means "untagged".  The string
+ *         need only live while it is the current tag.
+ */
+const char *alloc_set_tag(const char *tag);
+/*! \fn size_t alloc_live_bytes(const char *tag)
+ *  \brief Bytes currently allocated under tag, or under all tags if tag is NULL.
+ */
+size_t    alloc_live_bytes(const char *tag = NULL);
+/*! \fn size_t alloc_peak_bytes(const char *tag)
+ *  \brief High-water mark of alloc_live_bytes(tag) since tracking began.
+ */
+size_t    alloc_peak_bytes(const char *tag = NULL);
+/*! \fn void alloc_report(FILE *fp, int top)
+ *  \brief Print the top tags by peak bytes with their live bytes and the
+ *         allocations not yet released (leaks, if printed at the end).
+ */
+void      alloc_report(FILE *fp, int top = 20);
+/*! \def ROUTINES_ALLOC_TAGS
+ *  \brief Distinct tags tracked; later ones are lumped under "other". */
+#define   ROUTINES_ALLOC_TAGS     256
+
+/*! \class alloc_tag_scope
+ *  \brief Charge the allocations of the enclosing scope to tag, e.g.
+ *         { alloc_tag_scope t("density grid"); rho = three_dimensional_contiguous_array(n,n,n); }
+ */
+class alloc_tag_scope
+{
+	public:
+	explicit alloc_tag_scope(const char *tag) : prev_(alloc_set_tag(tag)) {}
+	~alloc_tag_scope() { alloc_set_tag(prev_); }
+
+	private:
+	alloc_tag_scope(const alloc_tag_scope &);
+	alloc_tag_scope &operator=(const alloc_tag_scope &);
+
+	const char *prev_;
+};
+/*! \struct arena
+ *  \brief Opaque bump-pointer allocator for short-lived temporaries.
+ *
+ *  Memory handed out by arena_alloc, and by the routines below that take
+ *  an arena, is never freed individually.  Call arena_reset once the
+ *  temporaries are dead (e.g. once per timestep) to make the whole arena
+ *  available again.  An arena grows by chaining extra blocks when it runs
+ *  out; arena_reset then merges them into one block, so after the first
+ *  step a steady workload does no malloc or free at all.  An arena must
+ *  not be shared between threads.
+ */
+struct arena;
+/*! \def ROUTINES_ARENA_ALIGNMENT
+ *  \brief Default alignment in bytes of arena_alloc allocations. */
+#define   ROUTINES_ARENA_ALIGNMENT 16
+/*! \fn arena *arena_create(size_t nbytes)
+ *  \brief Create an arena with an initial block of nbytes
+ */
+arena    *arena_create(size_t nbytes);
+/*! \fn void arena_destroy(arena *a)
+ *  \brief Release an arena and all memory allocated from it
+ */
+void      arena_destroy(arena *a);
+/*! \fn void arena_reset(arena *a)
+ *  \brief Invalidate all allocations from an arena so its memory can be reused
+ */
+void      arena_reset(arena *a);
+/*! \fn void *arena_alloc(arena *a, size_t n, size_t size, size_t alignment)
+ *  \brief Allocate uninitialized space for n elements of size bytes from an arena
+ */
+void     *arena_alloc(arena *a, size_t n, size_t size, size_t alignment = ROUTINES_ARENA_ALIGNMENT);
+/*! \fn size_t arena_bytes_used(const arena *a)
+ *  \brief Number of bytes allocated from an arena since the last reset
+ */
+size_t    arena_bytes_used(const arena *a);
+/*! \fn double **two_dimensional_contiguous_array(size_t n, size_t l, arena *a, array_init init, double value)
+ *  \brief Allocate a contiguous two dimensional (n x l) array from an arena, zeroed by default.
+ *         Do not deallocate; it is released by arena_reset.
+ */
+double  **two_dimensional_contiguous_array(size_t n, size_t l, arena *a, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, arena *a, array_init init, double value)
+ *  \brief Allocate a contiguous three dimensional (n x l x m) array from an arena, zeroed by default.
+ *         Do not deallocate; it is released by arena_reset.
+ */
+double ***three_dimensional_contiguous_array(size_t n, size_t l, size_t m, arena *a, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, arena *a, array_init init, double value)
+ *  \brief Allocate a contiguous four dimensional (n x l x m x p) array from an arena, zeroed by default.
+ *         Do not deallocate; it is released by arena_reset.
+ */
+double ****four_dimensional_contiguous_array(size_t n, size_t l, size_t m, size_t p, arena *a, array_init init = ARRAY_ZEROED, double value = 0);
+/*! \fn int ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, arena *a, array_init init, int value)
+ *  \brief Allocate a contiguous three dimensional (n x l x m) int array from an arena, zeroed by default.
+ *         Do not deallocate; it is released by arena_reset.
+ */
+int    ***three_dimensional_contiguous_int_array(size_t n, size_t l, size_t m, arena *a, array_init init = ARRAY_ZEROED, int value = 0);
+/*! \enum array_dtype
+ *  \brief Element type recorded in the header of a binary array file. */
+enum array_dtype {DTYPE_DOUBLE = 1, DTYPE_FLOAT = 2, DTYPE_INT = 3};
+/*! \def ROUTINES_ARRAY_MAX_RANK
+ *  \brief Largest number of dimensions a binary array file may record. */
+#define   ROUTINES_ARRAY_MAX_RANK 4
+/*! \def ROUTINES_IO_BLOCK
+ *  \brief Default size in bytes of the buffer the array writers gather
+ *         rows into (4 MB); may be defined before this header. */
+#ifndef   ROUTINES_IO_BLOCK
+#define   ROUTINES_IO_BLOCK 4194304
+#endif
+/*! \fn void array_io_block_set(size_t nbytes)
+ *  \brief Set the size of the buffer the array writers gather the rows of
+ *         non-contiguous arrays into before handing them to stdio; rows of
+ *         at least nbytes are written directly.  Affects later writes only.
+ */
+void      array_io_block_set(size_t nbytes = ROUTINES_IO_BLOCK);
+/*! \fn void fwrite_brant(const void *x, size_t size, size_t n, FILE *fp)
+ *  \brief Safe method for writing n elements of size bytes from x.
+ */
+void      fwrite_brant(const void *x, size_t size, size_t n, FILE *fp);
+/*! \fn void fread_brant(void *x, size_t size, size_t n, FILE *fp)
+ *  \brief Safe method for reading n elements of size bytes into x.
+ */
+void      fread_brant(void *x, size_t size, size_t n, FILE *fp);
+/*! \fn void write_array_header(FILE *fp, array_dtype dtype, int rank, const size_t *shape)
+ *  \brief Write the 64 byte header of a binary array file: type, rank,
+ *         the rank extents in shape, and the byte order.  The row-major
+ *         elements follow it.
+ */
+void      write_array_header(FILE *fp, array_dtype dtype, int rank, const size_t *shape);
+/*! \fn void read_array_header(FILE *fp, array_dtype dtype, int rank, size_t *shape)
+ *  \brief Read the header of a binary array file, checking that it holds a
+ *         rank dimensional array of dtype in this machine's byte order, and
+ *         store its extents in shape.
+ */
+void      read_array_header(FILE *fp, array_dtype dtype, int rank, size_t *shape);
+/*! \fn void write_double_array(FILE *fp, double *x, size_t n)
+ *  \brief Write a double array of n elements, with header, in one call.
+ */
+void      write_double_array(FILE *fp, double *x, size_t n);
+/*! \fn double *read_double_array(FILE *fp, int *n)
+ *  \brief Read a double array written by write_double_array; n is set to
+ *         its size.
+ */
+double   *read_double_array(FILE *fp, int *n);
+/*! \fn double *read_double_array(FILE *fp, size_t *n)
+ *  \brief As read_double_array, for files with more than INT_MAX elements,
+ *         which the int form rejects.
+ */
+double   *read_double_array(FILE *fp, size_t *n);
+/*! \fn void write_two_dimensional_array(FILE *fp, double **x, size_t n, size_t l)
+ *  \brief Write an (n x l) array from two_dimensional_array or
+ *         two_dimensional_contiguous_array, with header, in large blocks.
+ */
+void      write_two_dimensional_array(FILE *fp, double **x, size_t n, size_t l);
+/*! \fn double **read_two_dimensional_array(FILE *fp, int *n, int *l)
+ *  \brief Read an array written by write_two_dimensional_array into a new
+ *         two_dimensional_contiguous_array; n and l are set to its shape.
+ */
+double  **read_two_dimensional_array(FILE *fp, int *n, int *l);
+/*! \fn double **read_two_dimensional_array(FILE *fp, size_t *n, size_t *l)
+ *  \brief As read_two_dimensional_array, for extents past INT_MAX.
+ */
+double  **read_two_dimensional_array(FILE *fp, size_t *n, size_t *l);
+/*! \fn void write_three_dimensional_array(FILE *fp, double ***x, size_t n, size_t l, size_t m)
+ *  \brief Write an (n x l x m) array from three_dimensional_array or
+ *         three_dimensional_contiguous_array, with header, in large blocks.
+ */
+void      write_three_dimensional_array(FILE *fp, double ***x, size_t n, size_t l, size_t m);
+/*! \fn double ***read_three_dimensional_array(FILE *fp, int *n, int *l, int *m)
+ *  \brief Read an array written by write_three_dimensional_array into a new
+ *         three_dimensional_contiguous_array; n, l and m are set to its shape.
+ */
+double ***read_three_dimensional_array(FILE *fp, int *n, int *l, int *m);
+/*! \fn double ***read_three_dimensional_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+ *  \brief As read_three_dimensional_array, for extents past INT_MAX.
+ */
+double ***read_three_dimensional_array(FILE *fp, size_t *n, size_t *l, size_t *m);
+/*! \fn void write_float_array(FILE *fp, float *x, size_t n)
+ *  \brief As write_double_array, for a float array.
+ */
+void      write_float_array(FILE *fp, float *x, size_t n);
+/*! \fn float *read_float_array(FILE *fp, size_t *n)
+ *  \brief Read a float array written by write_float_array into a new
+ *         calloc_float_array; n is set to its size.
+ */
+float    *read_float_array(FILE *fp, size_t *n);
+/*! \fn void write_two_dimensional_float_array(FILE *fp, float **x, size_t n, size_t l)
+ *  \brief As write_two_dimensional_array, for an (n x l) array from
+ *         two_dimensional_contiguous_float_array.
+ */
+void      write_two_dimensional_float_array(FILE *fp, float **x, size_t n, size_t l);
+/*! \fn float **read_two_dimensional_float_array(FILE *fp, size_t *n, size_t *l)
+ *  \brief Read an array written by write_two_dimensional_float_array into a
+ *         new two_dimensional_contiguous_float_array; n and l are set to its shape.
+ */
+float   **read_two_dimensional_float_array(FILE *fp, size_t *n, size_t *l);
+/*! \fn void write_three_dimensional_float_array(FILE *fp, float ***x, size_t n, size_t l, size_t m)
+ *  \brief As write_three_dimensional_array, for an (n x l x m) array from
+ *         three_dimensional_contiguous_float_array.
+ */
+void      write_three_dimensional_float_array(FILE *fp, float ***x, size_t n, size_t l, size_t m);
+/*! \fn float ***read_three_dimensional_float_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+ *  \brief Read an array written by write_three_dimensional_float_array into a
+ *         new three_dimensional_contiguous_float_array; n, l and m are set to its shape.
+ */
+float  ***read_three_dimensional_float_array(FILE *fp, size_t *n, size_t *l, size_t *m);
+/*! \fn void write_int_array(FILE *fp, int *x, size_t n)
+ *  \brief As write_double_array, for an int array.
+ */
+void      write_int_array(FILE *fp, int *x, size_t n);
+/*! \fn int *read_int_array(FILE *fp, size_t *n)
+ *  \brief Read an int array written by write_int_array into a new
+ *         calloc_int_array; n is set to its size.
+ */
+int      *read_int_array(FILE *fp, size_t *n);
+/*! \fn void write_three_dimensional_int_array(FILE *fp, int ***x, size_t n, size_t l, size_t m)
+ *  \brief As write_three_dimensional_array, for an (n x l x m) array from
+ *         three_dimensional_int_array or three_dimensional_contiguous_int_array.
+ */
+void      write_three_dimensional_int_array(FILE *fp, int ***x, size_t n, size_t l, size_t m);
+/*! \fn int ***read_three_dimensional_int_array(FILE *fp, size_t *n, size_t *l, size_t *m)
+ *  \brief Read an array written by write_three_dimensional_int_array into a
+ *         new three_dimensional_contiguous_int_array; n, l and m are set to its shape.
+ */
+int    ***read_three_dimensional_int_array(FILE *fp, size_t *n, size_t *l, size_t *m);
+/*! \enum array_map_mode
+ *  \brief How map_* routines map a file.  Read-only mappings share the
+ *         page cache between processes; writing to one is an error.
+ *         Copy-on-write mappings may be written, but changes stay private
+ *         to the process and never reach the file. */
+enum array_map_mode {ARRAY_MAP_READ_ONLY, ARRAY_MAP_COPY_ON_WRITE};
+/*! \enum array_map_advice
+ *  \brief Expected access pattern of a mapped array, passed to madvise. */
+enum array_map_advice {ARRAY_ADVICE_NORMAL, ARRAY_ADVICE_SEQUENTIAL, ARRAY_ADVICE_RANDOM, ARRAY_ADVICE_WILLNEED};
+/*! \fn double *map_double_array(char fname[], int *n, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_double_array instead of reading it;
+ *         n is set to its size.  Release with unmap_double_array.
+ */
+double   *map_double_array(char fname[], int *n, array_map_mode mode = ARRAY_MAP_READ_ONLY, array_map_advice advice = ARRAY_ADVICE_NORMAL);
+/*! \fn double *map_double_array(char fname[], size_t *n, array_map_mode mode, array_map_advice advice)
+ *  \brief As map_double_array, for files with more than INT_MAX elements,
+ *         which the int form rejects.
+ */
+double   *map_double_array(char fname[], size_t *n, array_map_mode mode = ARRAY_MAP_READ_ONLY, array_map_advice advice = ARRAY_ADVICE_NORMAL);
+/*! \fn void unmap_double_array(double *x, size_t n)
+ *  \brief Unmap an array from map_double_array
+ */
+void      unmap_double_array(double *x, size_t n);
+/*! \fn double **map_two_dimensional_array(char fname[], int *n, int *l, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_two_dimensional_array as an (n x l)
+ *         array laid out like two_dimensional_contiguous_array.  Release
+ *         with unmap_two_dimensional_array.
+ */
+double  **map_two_dimensional_array(char fname[], int *n, int *l, array_map_mode mode = ARRAY_MAP_READ_ONLY, array_map_advice advice = ARRAY_ADVICE_NORMAL);
+/*! \fn double **map_two_dimensional_array(char fname[], size_t *n, size_t *l, array_map_mode mode, array_map_advice advice)
+ *  \brief As map_two_dimensional_array, for extents past INT_MAX.
+ */
+double  **map_two_dimensional_array(char fname[], size_t *n, size_t *l, array_map_mode mode = ARRAY_MAP_READ_ONLY, array_map_advice advice = ARRAY_ADVICE_NORMAL);
+/*! \fn void unmap_two_dimensional_array(double **x, size_t n, size_t l)
+ *  \brief Unmap an array from map_two_dimensional_array
+ */
+void      unmap_two_dimensional_array(double **x, size_t n, size_t l);
+/*! \fn double ***map_three_dimensional_array(char fname[], int *n, int *l, int *m, array_map_mode mode, array_map_advice advice)
+ *  \brief Map a file written by write_three_dimensional_array as an
+ *         (n x l x m) array laid out like three_dimensional_contiguous_array.
+ *         Release with unmap_three_dimensional_array.
+ */
+double ***map_three_dimensional_array(char fname[], int *n, int *l, int *m, array_map_mode mode = ARRAY_MAP_READ_ONLY, array_map_advice advice = ARRAY_ADVICE_NORMAL);
+/*! \fn double ***map_three_dimensional_array(char fname[], size_t *n, size_t *l, size_t *m, array_map_mode mode, array_map_advice advice)
+ *  \brief As map_three_dimensional_array, for extents past INT_MAX.
+ */
+double ***map_three_dimensional_array(char fname[], size_t *n, size_t *l, size_t *m, array_map_mode mode = ARRAY_MAP_READ_ONLY, array_map_advice advice = ARRAY_ADVICE_NORMAL);
+/*! \fn void unmap_three_dimensional_array(double ***x, size_t n, size_t l, size_t m)
+ *  \brief Unmap an array from map_three_dimensional_array
+ */
+void      unmap_three_dimensional_array(double ***x, size_t n, size_t l, size_t m);
 /*! \fn double max_three(double a, double b, double c)
  *  \brief Returns the max of 3 numbers */
 double    max_three(double a, double b, double c);
@@ -76,10 +587,120 @@ double    max_three(double a, double b, double c);
  *  \brief Function to compare doubles, for use with qsort.
  */
 int       compare_doubles(const void *a, const void *b);
+/*! \fn void array_sort(double *x, size_t n)
+ *  \brief Sort x into ascending order, in place.  A radix sort on the
+ *         bits of the doubles, for use instead of qsort with
+ *         compare_doubles: the order of numbers is the same, -0 comes
+ *         before +0, and NaNs, which compare_doubles leaves in no
+ *         particular place, are all moved to the end in their original
+ *         order.  Uses 2n words of scratch memory.
+ */
+void      array_sort(double *x, size_t n);
+/*! \fn void array_sort_parallel(double *x, size_t n)
+ *  \brief As array_sort, with the passes split across OpenMP threads.
+ *         The result is identical to array_sort's for any number of threads.
+ */
+void      array_sort_parallel(double *x, size_t n);
 /*! \fn double time_in_seconds(clock_t A, clock_t B)
- *  \brief Returns time difference B-A in seconds for two clock_t
+ *  \brief Returns time difference B-A in seconds for two clock_t.
+ *         clock() is process CPU time summed over all threads; time
+ *         parallel code with wall_time or thread_cpu_time instead.
  */
 double    time_in_seconds(clock_t A, clock_t B);
+/*! \fn double wall_time(void)
+ *  \brief Seconds on a monotonic clock (CLOCK_MONOTONIC, as
+ *         std::chrono::steady_clock) with ns resolution.  Only
+ *         differences are meaningful.
+ */
+double    wall_time(void);
+/*! \fn double thread_cpu_time(void)
+ *  \brief CPU seconds used so far by the calling thread.
+ */
+double    thread_cpu_time(void);
+
+/*! \def ROUTINES_TIMER_THREADS
+ *  \brief Threads whose timer_region statistics are kept in private,
+ *         lock-free slots at any one time.  Slots are given back when a
+ *         thread exits; threads beyond this many alive at once share one
+ *         slot under a lock. */
+#define ROUTINES_TIMER_THREADS 64
+
+/*! \struct timer_region
+ *  \brief Opaque named timing region.  Counts, total, min and max wall
+ *         time (and optionally thread CPU time) of each interval added to
+ *         it, aggregated over all threads.
+ */
+struct timer_region;
+
+/*! \fn timer_region *timer_region_get(const char *name, bool cpu_time)
+ *  \brief Return the region called name, creating it on first use.  Look
+ *         a region up once and keep the pointer; regions last until exit.
+ *         With cpu_time the thread CPU time of each interval is also
+ *         summed, at the cost of a system call per interval.
+ *         The first region created arranges for timer_summary(stdout)
+ *         to be printed at exit, see timer_summary_at_exit.
+ */
+timer_region *timer_region_get(const char *name, bool cpu_time = false);
+/*! \fn bool timer_region_cpu_time(const timer_region *r)
+ *  \brief True if r records thread CPU time.
+ */
+bool      timer_region_cpu_time(const timer_region *r);
+/*! \fn void timer_region_add(timer_region *r, double wall, double cpu)
+ *  \brief Record one interval of wall seconds, and cpu CPU seconds, in r.
+ *         Thread safe, and lock free while at most ROUTINES_TIMER_THREADS
+ *         threads that add to timers are alive.
+ */
+void      timer_region_add(timer_region *r, double wall, double cpu = 0);
+/*! \fn void timer_summary(FILE *fp)
+ *  \brief Print count, total, mean, min and max of every region to fp.
+ */
+void      timer_summary(FILE *fp);
+/*! \fn void timer_summary_at_exit(bool enable)
+ *  \brief Choose whether timer_summary(stdout) is printed at exit (default yes).
+ */
+void      timer_summary_at_exit(bool enable);
+/*! \fn void timer_reset(void)
+ *  \brief Zero the statistics of every region.  Call only while no
+ *         intervals are being recorded.
+ */
+void      timer_reset(void);
+
+/*! \class scoped_timer
+ *  \brief Adds the time between its construction and destruction to a
+ *         timer_region, e.g.
+ *
+ *         static timer_region *r = timer_region_get("solve");
+ *         { scoped_timer t(r); solve(); }
+ *
+ *         or ROUTINES_TIMED_SCOPE("solve") for the same in one line.
+ */
+class scoped_timer
+{
+	public:
+	explicit scoped_timer(timer_region *r) : r_(r), cpu_(timer_region_cpu_time(r) ? thread_cpu_time() : 0), wall_(wall_time()) {}
+	~scoped_timer()
+	{
+		double wall = wall_time() - wall_;
+		timer_region_add(r_, wall, timer_region_cpu_time(r_) ? thread_cpu_time() - cpu_ : 0);
+	}
+
+	private:
+	scoped_timer(const scoped_timer &);
+	scoped_timer &operator=(const scoped_timer &);
+
+	timer_region *r_;
+	double        cpu_;
+	double        wall_;
+};
+
+#define ROUTINES_CONCAT_(a,b) a##b
+#define ROUTINES_CONCAT(a,b)  ROUTINES_CONCAT_(a,b)
+/*! \def ROUTINES_TIMED_SCOPE(name)
+ *  \brief Time the rest of the enclosing scope in the region called name.
+ *         The region is looked up only the first time the line runs. */
+#define ROUTINES_TIMED_SCOPE(name) \
+	static timer_region *ROUTINES_CONCAT(routines_region_,__LINE__) = timer_region_get(name); \
+	scoped_timer ROUTINES_CONCAT(routines_scope_,__LINE__)(ROUTINES_CONCAT(routines_region_,__LINE__))
 /*! \fn double double double_linear_index(int i, int n, double xmin, double xmax)
  *  \brief Provides the i^th out of n linear incremented value between xmin and xmax.
  *	   Useful for creating a ordinate array for an interpolation.
@@ -90,46 +711,432 @@ double double_linear_index(int i, int n, double xmin, double xmax);
  *	   Useful for creating a ordinate array for an interpolation.
  */
 double double_log10_index(int i, int n, double xmin, double xmax);
+/*! \fn void fill_linear_grid(double *x, int n, double xmin, double xmax)
+ *  \brief Fill x[0..n-1] with the values of double_linear_index(i,n,xmin,xmax),
+ *         to within an ulp, in one pass.  The end points are exactly xmin
+ *         and xmax.
+ */
+void      fill_linear_grid(double *x, int n, double xmin, double xmax);
+/*! \fn void fill_log10_grid(double *x, int n, double xmin, double xmax)
+ *  \brief Fill x[0..n-1] with the values of double_log10_index(i,n,xmin,xmax),
+ *         using about n/64 calls to pow instead of n.  The error does not
+ *         grow with n and is no larger than double_log10_index's own, which
+ *         is set by rounding the exponent.  The end points are exactly xmin
+ *         and xmax.
+ */
+void      fill_log10_grid(double *x, int n, double xmin, double xmax);
 /*! \fn void create_linear_spline(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
  *  \brief Routine to create a spline, interpolated linear.
  */
-void     create_linear_spline(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *spline, gsl_interp_accel *acc);
+void     create_linear_spline(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc);
 /*! \fn void create_log10_spline(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc)
  *  \brief Routine to make a spline, interpolating in log10.
  */
 void     create_log10_spline(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc);
+/*! \fn void create_linear_spline_parallel(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief As create_linear_spline, but func is evaluated at the nodes
+ *         concurrently by OpenMP threads, so func must be safe to call
+ *         from several threads at once.  At most max_threads threads are
+ *         used; 0 means the OpenMP default and 1 evaluates serially.
+ */
+void     create_linear_spline_parallel(double (*func)(double, void *), double *x, double *&y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads = 0);
+/*! \fn void create_log10_spline_parallel(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief As create_log10_spline, but func is evaluated at the nodes
+ *         concurrently by OpenMP threads, so func must be safe to call
+ *         from several threads at once.  At most max_threads threads are
+ *         used; 0 means the OpenMP default and 1 evaluates serially.
+ */
+void     create_log10_spline_parallel(double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads = 0);
+/*! \fn double create_log10_spline_adaptive(double (*func)(double, void *), double log10xmin, double log10xmax, double tol, double *&log10x, double *&log10y, int &n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int n_max, int max_threads)
+ *  \brief Routine to make a spline, interpolating in log10, whose nodes
+ *         are placed where func needs them.  Starting from n nodes
+ *         uniform in log10 x between log10xmin and log10xmax, the
+ *         midpoint of every interval is checked against func and intervals
+ *         missing log10(func) there by more than tol are split, until none
+ *         is or the table reaches n_max nodes.  log10x and log10y are
+ *         allocated to the final table and n is set to its size.  Returns
+ *         the largest midpoint error of the final table, which exceeds tol
+ *         only if n_max was reached.  max_threads is as for
+ *         create_log10_spline_parallel.
+ */
+double    create_log10_spline_adaptive(double (*func)(double, void *), double log10xmin, double log10xmax, double tol, double *&log10x, double *&log10y, int &n, double *params, gsl_spline *&spline, gsl_interp_accel *&acc, int n_max = 4096, int max_threads = 1);
+/*! \fn double spline_eval(const gsl_spline *spline, double x)
+ *  \brief Evaluate a spline from create_linear_spline, create_log10_spline
+ *         or their variants at x without a caller-supplied gsl_interp_accel.
+ *         Each thread keeps its own accelerator for the last few splines it
+ *         evaluated, so one spline may be shared by any number of threads
+ *         without locks, provided none of them modifies it.
+ */
+double    spline_eval(const gsl_spline *spline, double x);
+/*! \fn void spline_eval_many(const gsl_spline *spline, const double *x, int n, double *y)
+ *  \brief Evaluate a spline at n points, y[i] = spline(x[i]), with the same
+ *         thread safety as spline_eval.
+ */
+void      spline_eval_many(const gsl_spline *spline, const double *x, int n, double *y);
+/*! \fn void create_linear_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *x, double *&y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief As create_linear_spline_parallel, but the table of y is kept in
+ *         a memory-mappable file in cache_dir, keyed by func_id and a hash
+ *         of the n_params values in params and of the grid x.  A later call
+ *         with the same key reads y from the file instead of calling func.
+ *         func_id must change whenever func itself does.  Cache files that
+ *         are missing, stale or unwritable are ignored.
+ */
+void     create_linear_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *x, double *&y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads = 0);
+/*! \fn void create_log10_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads)
+ *  \brief As create_log10_spline_parallel, with the table of log10y cached
+ *         on disk as for create_linear_spline_cached.
+ */
+void     create_log10_spline_cached(const char *cache_dir, const char *func_id, double (*func)(double, void *), double *log10x, double *&log10y, int n, double *params, int n_params, gsl_spline *&spline, gsl_interp_accel *&acc, int max_threads = 0);
+/*! \struct uniform_spline
+ *  \brief Opaque natural cubic spline on a uniform grid, the same
+ *         interpolant gsl_interp_cspline builds from those nodes.
+ *
+ *  The interval holding x is found with one multiply instead of a
+ *  search, and each interval's four polynomial coefficients are stored
+ *  together.  Evaluation keeps no state, so one uniform_spline may be
+ *  evaluated from many threads at once.  Points outside [xmin, xmax] are
+ *  extrapolated from the end intervals rather than rejected.
+ */
+struct uniform_spline;
+/*! \fn uniform_spline *uniform_spline_alloc(double xmin, double xmax, const double *y, int n)
+ *  \brief Build a uniform spline through the n >= 2 values y[i] at
+ *         x_i = double_linear_index(i,n,xmin,xmax).
+ */
+uniform_spline *uniform_spline_alloc(double xmin, double xmax, const double *y, int n);
+/*! \fn void uniform_spline_free(uniform_spline *s)
+ *  \brief Free a uniform spline
+ */
+void      uniform_spline_free(uniform_spline *s);
+/*! \fn double uniform_spline_eval(const uniform_spline *s, double x)
+ *  \brief Evaluate a uniform spline at x
+ */
+double    uniform_spline_eval(const uniform_spline *s, double x);
+/*! \fn void uniform_spline_eval_many(const uniform_spline *s, const double *x, int n, double *y)
+ *  \brief Evaluate a uniform spline at n points, y[i] = s(x[i]), with
+ *         the same results as uniform_spline_eval.  Uses gather
+ *         instructions on cpus with AVX2 or AVX-512.
+ */
+void      uniform_spline_eval_many(const uniform_spline *s, const double *x, int n, double *y);
+/*! \fn uniform_spline *create_linear_uniform_spline(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads)
+ *  \brief Routine to create a uniform spline of func(x,params) on n nodes
+ *         between xmin and xmax.  max_threads is as for
+ *         create_linear_spline_parallel.
+ */
+uniform_spline *create_linear_uniform_spline(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads = 1);
+/*! \fn uniform_spline *create_log10_uniform_spline(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads)
+ *  \brief Routine to make a uniform spline of log10(func(x,params)) in log10 x,
+ *         on n nodes uniform in log10 x between log10xmin and log10xmax, i.e.
+ *         the grid of double_log10_index.  Evaluate it at log10 x.
+ */
+uniform_spline *create_log10_uniform_spline(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads = 1);
 
+/*! \struct uniform_spline_float
+ *  \brief Opaque uniform spline with its coefficients stored, and
+ *         evaluated, in float.
+ *
+ *  The coefficients are found in double, as for uniform_spline, and then
+ *  rounded, so the table takes half the memory and the eval_many kernels
+ *  handle twice as many points per instruction.  Evaluation has float
+ *  precision in both x and the result; in particular the position within
+ *  an interval is resolved to about n/2^24 of an interval.
+ */
+struct uniform_spline_float;
+/*! \fn uniform_spline_float *uniform_spline_float_alloc(double xmin, double xmax, const double *y, int n)
+ *  \brief Build a float uniform spline through the n >= 2 values y[i] at
+ *         x_i = double_linear_index(i,n,xmin,xmax).
+ */
+uniform_spline_float *uniform_spline_float_alloc(double xmin, double xmax, const double *y, int n);
+/*! \fn void uniform_spline_free(uniform_spline_float *s)
+ *  \brief Free a float uniform spline
+ */
+void      uniform_spline_free(uniform_spline_float *s);
+/*! \fn float uniform_spline_eval(const uniform_spline_float *s, float x)
+ *  \brief Evaluate a float uniform spline at x
+ */
+float     uniform_spline_eval(const uniform_spline_float *s, float x);
+/*! \fn void uniform_spline_eval_many(const uniform_spline_float *s, const float *x, int n, float *y)
+ *  \brief Evaluate a float uniform spline at n points, y[i] = s(x[i]), with
+ *         the same results as uniform_spline_eval.
+ */
+void      uniform_spline_eval_many(const uniform_spline_float *s, const float *x, int n, float *y);
+/*! \fn uniform_spline_float *create_linear_uniform_spline_float(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads)
+ *  \brief As create_linear_uniform_spline, with a float table.
+ */
+uniform_spline_float *create_linear_uniform_spline_float(double (*func)(double, void *), double xmin, double xmax, int n, double *params, int max_threads = 1);
+/*! \fn uniform_spline_float *create_log10_uniform_spline_float(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads)
+ *  \brief As create_log10_uniform_spline, with a float table.
+ */
+uniform_spline_float *create_log10_uniform_spline_float(double (*func)(double, void *), double log10xmin, double log10xmax, int n, double *params, int max_threads = 1);
 
-/*! \fn double array_max(double *x, int n)
+
+/*! \fn double array_max(double *x, size_t n)
  *  \brief Find the maximum of array x */
-double array_max(double *x, int n);
+double array_max(double *x, size_t n);
 
-/*! \fn double array_min(double *x, int n)
+/*! \fn double array_min(double *x, size_t n)
  *  \brief Find the minimum of array x */
-double array_min(double *x, int n);
+double array_min(double *x, size_t n);
+
+/*! \fn void array_minmax(double *x, size_t n, double *min, double *max)
+ *  \brief Find the minimum and maximum of array x in a single pass */
+void array_minmax(double *x, size_t n, double *min, double *max);
 
-/*! \fn double vector_dot_product(double *x, double *y, int n); 
+/*! \fn double vector_dot_product(double *x, double *y, size_t n); 
  *  \brief Find the dot product of x * y */
-double vector_dot_product(double *x, double *y, int n);
+double vector_dot_product(double *x, double *y, size_t n);
 
-/*! \fn double vector_magnitude(double *x, int n)
+/*! \fn double vector_magnitude(double *x, size_t n)
  *  \brief Find the magnitude of x */
-double vector_magnitude(double *x, int n);
+double vector_magnitude(double *x, size_t n);
+
+/*! \fn float array_max(float *x, size_t n)
+ *  \brief Find the maximum of float array x */
+float array_max(float *x, size_t n);
+
+/*! \fn float array_min(float *x, size_t n)
+ *  \brief Find the minimum of float array x */
+float array_min(float *x, size_t n);
+
+/*! \fn void array_minmax(float *x, size_t n, float *min, float *max)
+ *  \brief Find the minimum and maximum of float array x in a single pass */
+void array_minmax(float *x, size_t n, float *min, float *max);
+
+/*! \fn double vector_dot_product(float *x, float *y, size_t n)
+ *  \brief Find the dot product of float vectors x * y, accumulated in
+ *         double.  Each product is exact in double, so the result is as
+ *         accurate as the double routine given the same values. */
+double vector_dot_product(float *x, float *y, size_t n);
+
+/*! \fn double vector_magnitude(float *x, size_t n)
+ *  \brief Find the magnitude of float vector x, accumulated in double */
+double vector_magnitude(float *x, size_t n);
+
+/*! \enum summation_mode
+ *  \brief Accumulation strategy for vector_dot_product and vector_magnitude.
+ *
+ *  SUMMATION_NAIVE is the default multi-accumulator SIMD sum.
+ *  SUMMATION_PAIRWISE sums fixed blocks with it and adds the block sums
+ *  as a binary tree, so rounding error grows with log n instead of n.
+ *  SUMMATION_COMPENSATED carries the exact rounding error of every
+ *  product and partial sum (Kahan-Neumaier style, with fma products),
+ *  which is about as accurate as summing in twice the precision. */
+enum summation_mode
+{
+	SUMMATION_NAIVE,
+	SUMMATION_PAIRWISE,
+	SUMMATION_COMPENSATED
+};
+
+/*! \fn double vector_dot_product(double *x, double *y, size_t n, summation_mode mode)
+ *  \brief Find the dot product of x * y with the given summation mode */
+double vector_dot_product(double *x, double *y, size_t n, summation_mode mode);
+
+/*! \fn double vector_magnitude(double *x, size_t n, summation_mode mode)
+ *  \brief Find the magnitude of x with the given summation mode */
+double vector_magnitude(double *x, size_t n, summation_mode mode);
+
+/*! \fn double vector_magnitude_scaled(double *x, size_t n)
+ *  \brief Find the magnitude of x without overflow or underflow in the
+ *         intermediate sum of squares, by scaling with a power of two
+ *         set by the largest |x[i]| (as LAPACK's dnrm2 does) */
+double vector_magnitude_scaled(double *x, size_t n);
 
 /*! \fn double vector_cross_product(double *x, double *y, int n); 
  *  \brief Find the cross product of x x y */
 double *vector_cross_product(double *x, double *y, int n);
 
+/*! \fn double *vector_cross_product(double *x, double *y, int n, arena *a)
+ *  \brief Find the cross product of x x y, with the result taken from arena a */
+double *vector_cross_product(double *x, double *y, int n, arena *a);
+
 /*! \fn void vector_cross_product_in_place(double *r, double *x, double *y, int n); 
  *  \brief Find the cross product of x x y in place*/
 void vector_cross_product_in_place(double *r, double *x, double *y, int ndim);
 
+/*! \fn const char *simd_isa_name(void)
+ *  \brief Name of the instruction set chosen at runtime for the SIMD
+ *         kernels ("avx512f", "avx2", "neon" or "scalar") */
+const char *simd_isa_name(void);
+
+/*! \fn void vector_cross_product_batch_2d(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n)
+ *  \brief Find the cross products r[i] = x_i x y_i of n 2-vectors
+ *         stored as structure-of-arrays columns (xx[], xy[]) and (yx[], yy[]).
+ *         r may be one of the input columns. */
+void vector_cross_product_batch_2d(double *r, const double *xx, const double *xy, const double *yx, const double *yy, size_t n);
+
+/*! \fn void vector_cross_product_batch_3d(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+ *  \brief Find the cross products r_i = x_i x y_i of n 3-vectors
+ *         stored as structure-of-arrays columns.  The output columns
+ *         may be input columns. */
+void vector_cross_product_batch_3d(double *rx, double *ry, double *rz, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n);
+
+/*! \fn void vector_dot_product_batch_3d(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n)
+ *  \brief Find the dot products r[i] = x_i * y_i of n 3-vectors
+ *         stored as structure-of-arrays columns. */
+void vector_dot_product_batch_3d(double *r, const double *xx, const double *xy, const double *xz, const double *yx, const double *yy, const double *yz, size_t n);
+
+/*! \fn void vector_magnitude_batch_3d(double *r, const double *x, const double *y, const double *z, size_t n)
+ *  \brief Find the magnitudes r[i] = |v_i| of n 3-vectors
+ *         stored as structure-of-arrays columns. */
+void vector_magnitude_batch_3d(double *r, const double *x, const double *y, const double *z, size_t n);
+
+/*! \def ROUTINES_PARALLEL_CHUNK
+ *  \brief Number of elements each partial result of the *_parallel
+ *         reductions covers.  Inputs shorter than two chunks are reduced
+ *         serially. */
+#define ROUTINES_PARALLEL_CHUNK 32768
+
+/*! \fn double array_max_parallel(double *x, size_t n)
+ *  \brief Find the maximum of array x using all OpenMP threads */
+double array_max_parallel(double *x, size_t n);
+
+/*! \fn double array_min_parallel(double *x, size_t n)
+ *  \brief Find the minimum of array x using all OpenMP threads */
+double array_min_parallel(double *x, size_t n);
+
+/*! \fn void array_minmax_parallel(double *x, size_t n, double *min, double *max)
+ *  \brief Find the minimum and maximum of array x in one pass using all OpenMP threads */
+void array_minmax_parallel(double *x, size_t n, double *min, double *max);
+
+/*! \fn double vector_dot_product_parallel(double *x, double *y, size_t n)
+ *  \brief Find the dot product of x * y using all OpenMP threads.
+ *
+ *  The input is split into fixed ROUTINES_PARALLEL_CHUNK pieces whose
+ *  partial sums are added in order, so the result depends only on n and
+ *  the data, not on the number of threads or their scheduling. */
+double vector_dot_product_parallel(double *x, double *y, size_t n);
+
+/*! \fn double vector_magnitude_parallel(double *x, size_t n)
+ *  \brief Find the magnitude of x using all OpenMP threads, reproducibly
+ *         as for vector_dot_product_parallel */
+double vector_magnitude_parallel(double *x, size_t n);
+
+/*! \struct stream_minmax
+ *  \brief State of a streaming min/max reduction. */
+struct stream_minmax
+{
+	double min;
+	double max;
+	size_t n;
+};
+
+/*! \fn void stream_minmax_init(stream_minmax *s)
+ *  \brief Start a streaming min/max reduction */
+void stream_minmax_init(stream_minmax *s);
+
+/*! \fn void stream_minmax_update(stream_minmax *s, double *x, size_t n)
+ *  \brief Add the next n elements x, e.g. a chunk from chunk_reader_next,
+ *         to a streaming min/max reduction */
+void stream_minmax_update(stream_minmax *s, double *x, size_t n);
+
+/*! \fn void stream_minmax_finalize(stream_minmax *s, double *min, double *max)
+ *  \brief Return the min and max of all the elements seen, exactly as
+ *         array_minmax would for them in one array (NaN if any was NaN
+ *         or none was seen) */
+void stream_minmax_finalize(stream_minmax *s, double *min, double *max);
+
+/*! \struct stream_dot
+ *  \brief State of a streaming dot product; holds 1 MB of buffers between
+ *         stream_dot_init and stream_dot_finalize. */
+struct stream_dot
+{
+	double  sum;
+	double *x;
+	double *y;
+	size_t  n;
+	bool    flushed;
+};
+
+/*! \fn void stream_dot_init(stream_dot *s)
+ *  \brief Start a streaming dot product */
+void stream_dot_init(stream_dot *s);
+
+/*! \fn void stream_dot_update(stream_dot *s, double *x, double *y, size_t n)
+ *  \brief Add the next n elements of x and y to a streaming dot product.
+ *         Pass the same array as x and y to stream a magnitude. */
+void stream_dot_update(stream_dot *s, double *x, double *y, size_t n);
+
+/*! \fn double stream_dot_finalize(stream_dot *s)
+ *  \brief Return the dot product of all the elements seen, bit for bit
+ *         what vector_dot_product_parallel returns for them in one array,
+ *         however they were split.  The magnitude is its sqrt. */
+double stream_dot_finalize(stream_dot *s);
+
+/*! \def ROUTINES_STREAM_CHUNK
+ *  \brief Default chunk_reader chunk, in doubles (8 MB). */
+#define ROUTINES_STREAM_CHUNK (32*ROUTINES_PARALLEL_CHUNK)
+
+/*! \struct chunk_reader
+ *  \brief Opaque double-buffered reader of binary array files.  While the
+ *         caller works on one chunk the next is read in the background.
+ */
+struct chunk_reader;
+
+/*! \fn chunk_reader *chunk_reader_open(FILE *fp, int rank, size_t chunk)
+ *  \brief Read the header of a rank dimensional double array file written
+ *         by the write_* routines and start reading its elements in chunks
+ *         of chunk doubles.  fp must not be used until chunk_reader_close. */
+chunk_reader *chunk_reader_open(FILE *fp, int rank, size_t chunk = ROUTINES_STREAM_CHUNK);
+
+/*! \fn size_t chunk_reader_next(chunk_reader *r, double **x)
+ *  \brief Point x at the next chunk, in row-major order, and return its
+ *         length, or 0 once the array is exhausted.  The chunk stays valid
+ *         until the following call. */
+size_t chunk_reader_next(chunk_reader *r, double **x);
+
+/*! \fn void chunk_reader_close(chunk_reader *r)
+ *  \brief Release a chunk reader; fp is left open */
+void chunk_reader_close(chunk_reader *r);
+
 /*! \fn double **tensor_transformation(double **a, double **sigma, int ndim)
  *  \brief Apply transformation a to tensor sigma */
 double **tensor_transformation(double **a, double **sigma, int ndim);
 
+/*! \fn double **tensor_transformation(double **a, double **sigma, int ndim, arena *ar)
+ *  \brief Apply transformation a to tensor sigma, with the result taken
+ *         from arena ar as a contiguous (ndim x ndim) array */
+double **tensor_transformation(double **a, double **sigma, int ndim, arena *ar);
+
+/*! \fn void tensor_transformation_in_place(double **result, double **a, double **sigma, int ndim)
+ *  \brief Apply transformation a to tensor sigma, writing the result
+ *         into the caller's (ndim x ndim) array result.  result may be
+ *         sigma, but not a.  O(ndim^3), and allocates nothing for
+ *         ndim <= 8. */
+void tensor_transformation_in_place(double **result, double **a, double **sigma, int ndim);
+
+/*! \fn void tensor_transformation_batch(double *result, const double *a, const double *sigma, int ndim, size_t count)
+ *  \brief Apply one transformation a to count tensors.  a is one flat
+ *         row-major (ndim x ndim) matrix; sigma and result each hold count
+ *         such matrices back to back, e.g. the slab x[0][0] of a
+ *         three_dimensional_contiguous_array(count,ndim,ndim).  result may
+ *         be sigma.  Large batches are split across OpenMP threads. */
+void tensor_transformation_batch(double *result, const double *a, const double *sigma, int ndim, size_t count);
+
 /*! \fn double matrix_determinant(double **a, int ndim)
- *  \brief Find the determinant of a matrix or tensor */
+ *  \brief Find the determinant of a matrix or tensor.  ndim 2 and 3 are
+ *         expanded directly; larger ndim use LU decomposition of a copy,
+ *         leaving a unchanged. */
 double matrix_determinant(double **a, int ndim);
 
+/*! \fn double matrix_determinant_in_place(double *a, int ndim)
+ *  \brief Find the determinant of a flat row-major (ndim x ndim) matrix,
+ *         e.g. the slab x[0] of a two_dimensional_contiguous_array, by LU
+ *         decomposition with partial pivoting.  a is overwritten with the
+ *         row-permuted factors (unit-diagonal L below the diagonal, U on and
+ *         above it).  Returns 0 for a singular matrix. */
+double matrix_determinant_in_place(double *a, int ndim);
+
+/*! \fn void matrix_determinant_batch_2d(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n)
+ *  \brief Find the determinants r[i] of n 2x2 matrices stored as
+ *         structure-of-arrays columns, one column a_jk[] per element.
+ *         r may be one of the input columns. */
+void matrix_determinant_batch_2d(double *r, const double *a00, const double *a01, const double *a10, const double *a11, size_t n);
+
+/*! \fn void matrix_determinant_batch_3d(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n)
+ *  \brief Find the determinants r[i] of n 3x3 matrices stored as
+ *         structure-of-arrays columns, one column a_jk[] per element.
+ *         Each r[i] is the value matrix_determinant gives that matrix.
+ *         r may be one of the input columns. */
+void matrix_determinant_batch_3d(double *r, const double *a00, const double *a01, const double *a02, const double *a10, const double *a11, const double *a12, const double *a20, const double *a21, const double *a22, size_t n);
+
 #endif //BRANT_ROUTINES